@@ -0,0 +1,311 @@
+/*
+ Interval map.
+
+ Copyright (c) 2024 Thomas Bruckschlegel. All rights reserved.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * \brief Key domain of an interval map. A dense domain stores one value per
+ * key in [min, max] instead of a search tree. Integral and enum keys of up to
+ * 16 bits are dense by default, other key types with a small bounded domain
+ * can opt in by specializing, e.g.
+ *   template<> struct interval_map_domain<Color> {
+ *     static constexpr bool dense = true;
+ *     static constexpr long long min = 0;
+ *     static constexpr long long max = 7;
+ *   };
+ * Keys outside of [min, max] must not be used with a dense domain.
+ **/
+template<typename K, typename = void>
+struct interval_map_domain {
+  static constexpr bool dense = false;
+};
+
+namespace detail {
+template<typename K, bool = std::is_enum_v<K>>
+struct key_integer {
+  using type = K;
+};
+
+template<typename K>
+struct key_integer<K, true> {
+  using type = std::underlying_type_t<K>;
+};
+
+template<typename K>
+using key_integer_t = typename key_integer<K>::type;
+
+/**
+ * \brief Sort intervals by key and check that they are canonical.
+ * \param[in] list the key where each interval begins and its value.
+ * \param[in] val_begin the value of the keys before the first interval.
+ * \return the sorted intervals.
+ * \throws std::invalid_argument if the intervals aren't canonical.
+ **/
+template<typename K, typename V>
+std::vector<std::pair<K, V>> sorted_intervals(
+    std::initializer_list<std::pair<K, V>> list,
+    const V& val_begin) {
+  std::vector<std::pair<K, V>> intervals(list);
+  std::stable_sort(intervals.begin(), intervals.end(),
+      [](auto&& a, auto&& b) { return a.first < b.first; });
+
+  for (size_t i = 0; i < intervals.size(); ++i) {
+    const auto& previous = i == 0 ? val_begin : intervals[i - 1].second;
+    if (i > 0 && !(intervals[i - 1].first < intervals[i].first))
+      throw std::invalid_argument("interval keys must be unique");
+    if (i == 0 && intervals[i].second == previous)
+      throw std::invalid_argument(
+          "first value must differ from the initial value");
+    if (i > 0 && intervals[i].second == previous)
+      throw std::invalid_argument(
+          "consecutive map entries must not contain the same value");
+  }
+  return intervals;
+}
+}  // namespace detail
+
+template<typename K>
+struct interval_map_domain<K,
+    std::enable_if_t<(std::is_integral_v<K> || std::is_enum_v<K>) &&
+                     sizeof(K) <= 2>> {
+  static constexpr bool dense = true;
+  static constexpr long long min =
+      std::numeric_limits<detail::key_integer_t<K>>::min();
+  static constexpr long long max =
+      std::numeric_limits<detail::key_integer_t<K>>::max();
+};
+
+/**
+ * \brief Maps every key of K to a value of V. Consecutive keys with the same
+ * value are stored as one interval, i.e. the map holds the key where each
+ * interval begins and keys before the first interval map to the initial
+ * value.
+ *
+ * The representation is canonical: consecutive map entries never hold the
+ * same value and the first entry never holds the initial value.
+ *
+ * K needs to be copyable and comparable with operator<, V needs to be
+ * copyable and comparable with operator==. The allocator is used for the map
+ * nodes, see util/arena_allocator.hpp for allocators suited to heavy assign()
+ * churn.
+ *
+ * Keys with a dense interval_map_domain use the specialization below.
+ **/
+template<typename K,
+    typename V,
+    typename Allocator = std::allocator<std::pair<const K, V>>,
+    bool Dense = interval_map_domain<K>::dense>
+class interval_map {
+public:
+  using key_type = K;
+  using mapped_type = V;
+  using allocator_type = Allocator;
+
+  /**
+   * \brief Create an interval map with every key mapped to val.
+   * \param[in] val the initial value.
+   * \param[in] alloc the allocator used for the map nodes.
+   **/
+  explicit interval_map(const V& val, const Allocator& alloc = Allocator())
+      : val_begin_(val), map_(std::less<K>(), alloc) {
+  }
+
+  /**
+   * \brief Assign val to the keys in [key_begin, key_end), an empty range is
+   * ignored.
+   * \param[in] key_begin the first key.
+   * \param[in] key_end the key after the last one.
+   * \param[in] val the value.
+   **/
+  void assign(const K& key_begin, const K& key_end, const V& val) {
+    if (!(key_begin < key_end))
+      return;
+
+    // Values before key_begin and at key_end, before the range is replaced.
+    auto end_it = map_.upper_bound(key_end);
+    const V end_val =
+        end_it == map_.begin() ? val_begin_ : std::prev(end_it)->second;
+    auto begin_it = map_.lower_bound(key_begin);
+    const bool begin_differs =
+        !((begin_it == map_.begin() ? val_begin_
+                                    : std::prev(begin_it)->second) == val);
+
+    auto hint = map_.erase(begin_it, end_it);
+    if (!(end_val == val))
+      hint = map_.emplace_hint(hint, key_end, end_val);
+    if (begin_differs)
+      map_.emplace_hint(hint, key_begin, val);
+  }
+
+  /**
+   * \brief Replace the content with the given intervals. The intervals are
+   * sorted by key and have to be in canonical form.
+   * \param[in] list the key where each interval begins and its value.
+   * \throws std::invalid_argument if the intervals aren't canonical.
+   **/
+  void assign_list(std::initializer_list<std::pair<K, V>> list) {
+    const auto intervals = detail::sorted_intervals(list, val_begin_);
+    map_.clear();
+    for (auto&& [key, val] : intervals)
+      map_.emplace_hint(map_.end(), key, val);
+  }
+
+  /**
+   * \brief Look up the value of a key.
+   * \param[in] key the key.
+   * \return the value.
+   **/
+  const V& operator[](const K& key) const {
+    auto it = map_.upper_bound(key);
+    return it == map_.begin() ? val_begin_ : std::prev(it)->second;
+  }
+
+  /**
+   * \brief Get the number of intervals after the initial one.
+   * \return the number of map entries.
+   **/
+  size_t size() const {
+    return map_.size();
+  }
+
+  allocator_type get_allocator() const {
+    return map_.get_allocator();
+  }
+
+private:
+  V val_begin_;
+  std::map<K, V, std::less<K>, Allocator> map_;
+};
+
+/**
+ * \brief Interval map for keys with a small dense domain, see
+ * interval_map_domain. Stores one value per key, so operator[] is a single
+ * indexed load and assign() a fill of the key range. The API and the
+ * canonical-form checks are the same as for the tree based interval map.
+ **/
+template<typename K, typename V, typename Allocator>
+class interval_map<K, V, Allocator, true> {
+public:
+  using key_type = K;
+  using mapped_type = V;
+  using allocator_type = Allocator;
+
+  /**
+   * \brief Create an interval map with every key mapped to val.
+   * \param[in] val the initial value.
+   * \param[in] alloc the allocator, rebound for the value table.
+   **/
+  explicit interval_map(const V& val, const Allocator& alloc = Allocator())
+      : val_begin_(val),
+        values_(kDomainSize, slot{ val }, slot_allocator_t(alloc)) {
+  }
+
+  /**
+   * \brief Assign val to the keys in [key_begin, key_end), an empty range is
+   * ignored. Fills the range of the value table.
+   * \param[in] key_begin the first key.
+   * \param[in] key_end the key after the last one.
+   * \param[in] val the value.
+   **/
+  void assign(const K& key_begin, const K& key_end, const V& val) {
+    if (!(key_begin < key_end))
+      return;
+
+    // Only the value changes at key_begin ... key_end are affected.
+    const auto first = index(key_begin);
+    const auto last = index(key_end);
+    intervals_ -= is_change(first) +
+                  std::transform_reduce(values_.begin() + first,
+                      values_.begin() + last, values_.begin() + first + 1,
+                      size_t{}, std::plus<>(),
+                      [](const slot& a, const slot& b) {
+                        return static_cast<size_t>(!(a.value == b.value));
+                      });
+    std::fill(values_.begin() + first, values_.begin() + last, slot{ val });
+    intervals_ += is_change(first) + is_change(last);
+  }
+
+  /**
+   * \brief Replace the content with the given intervals. The intervals are
+   * sorted by key and have to be in canonical form.
+   * \param[in] list the key where each interval begins and its value.
+   * \throws std::invalid_argument if the intervals aren't canonical.
+   **/
+  void assign_list(std::initializer_list<std::pair<K, V>> list) {
+    const auto intervals = detail::sorted_intervals(list, val_begin_);
+    std::fill(values_.begin(), values_.end(), slot{ val_begin_ });
+    for (size_t i = 0; i < intervals.size(); ++i) {
+      const auto end = i + 1 < intervals.size()
+                           ? values_.begin() + index(intervals[i + 1].first)
+                           : values_.end();
+      std::fill(values_.begin() + index(intervals[i].first), end,
+          slot{ intervals[i].second });
+    }
+    intervals_ = intervals.size();
+  }
+
+  /**
+   * \brief Look up the value of a key, a single load without branches.
+   * \param[in] key the key.
+   * \return the value.
+   **/
+  const V& operator[](const K& key) const {
+    return values_[index(key)].value;
+  }
+
+  /**
+   * \brief Get the number of intervals after the initial one, the same as
+   * the number of map entries of the tree based interval map.
+   * \return the number of intervals.
+   **/
+  size_t size() const {
+    return intervals_;
+  }
+
+  allocator_type get_allocator() const {
+    return allocator_type(values_.get_allocator());
+  }
+
+private:
+  using domain_t = interval_map_domain<K>;
+  // Wraps the value so that bool isn't stored as a packed std::vector<bool>,
+  // which can't hand out references.
+  struct slot {
+    V value;
+  };
+  using slot_allocator_t =
+      typename std::allocator_traits<Allocator>::template rebind_alloc<slot>;
+
+  static constexpr size_t kDomainSize =
+      static_cast<size_t>(domain_t::max - domain_t::min) + 1;
+
+  static size_t index(const K& key) {
+    return static_cast<size_t>(static_cast<long long>(key) - domain_t::min);
+  }
+
+  // Whether an interval begins at index i.
+  size_t is_change(size_t i) const {
+    const V& previous = i == 0 ? val_begin_ : values_[i - 1].value;
+    return !(values_[i].value == previous);
+  }
+
+  V val_begin_;
+  std::vector<slot, slot_allocator_t> values_;
+  size_t intervals_{};
+};
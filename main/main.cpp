@@ -6,6 +6,11 @@
 
 #include "main.hpp"
 #include "util/perf_macros.h"
+#include "util/benchmark_runner.hpp"
+#include "util/arena_allocator.hpp"
+#include "interval_map.hpp"
+#include <charconv>
+#include <limits>
 
 using namespace std;
 
@@ -33,8 +38,55 @@ size_t my_distance(It first, It last) {
 #endif
 }
 
+// interval_map assign() churn, the update pattern of the
+// MustFireException_Error test over a larger key range. The ranges stay
+// within the 16 bit key range, so every key type does the same work.
+template<typename Map>
+size_t interval_map_churn(Map& map, size_t iterations) {
+  using key_t = typename Map::key_type;
+  size_t x = 0;
+  uint32_t seed = 1;
+  for (size_t i = 0; i < iterations; ++i) {
+    seed = seed * 1664525u + 1013904223u;
+    const int first = static_cast<int>((seed >> 8) % 65536) - 32768;
+    const int last = (std::min)(first + static_cast<int>(seed % 64) + 1,
+        static_cast<int>(std::numeric_limits<int16_t>::max()));
+    const auto begin = static_cast<key_t>(first);
+    const auto end = static_cast<key_t>(last);
+    map.assign(begin, end, static_cast<char>('A' + (seed >> 28) % 4));
+    x += map[begin];
+  }
+  return x + map.size();
+}
+
+// builds many short lived maps, kBuildAssigns assigns each
+template<typename Map, typename... Args>
+size_t interval_map_build(size_t iterations, Args&&... args) {
+  constexpr size_t kBuildAssigns = 1000;
+  size_t x = 0;
+  for (size_t i = 0; i < iterations; i += kBuildAssigns) {
+    Map map('X', std::forward<Args>(args)...);
+    x += interval_map_churn(map, kBuildAssigns);
+  }
+  return x;
+}
+
+// parses the whole text as a number, e.g. the "4" of --scaling=4
+template<typename T>
+bool parse_number(std::string_view text, T& value) {
+  const auto end = text.data() + text.size();
+  const auto [ptr, error] = std::from_chars(text.data(), end, value);
+  return error == std::errc() && ptr == end;
+}
+
+void print_usage() {
+  std::cerr << "usage: main [--scaling[=N]] [--pin=CPU] [--high-priority]\n"
+               "            [--lock-memory[=MB]] [--shared-metrics[=NAME]]"
+            << std::endl;
+}
+
 // main entry point
-int main() {
+int main(int argc, char** argv) {
   std::shared_ptr<performance::PerformanceProfiler> profiler;
   profiler = std::make_shared<performance::PerformanceProfiler>(
       [](const std::string& segment_name, double value,
@@ -67,21 +119,22 @@ int main() {
 
   LOG_MEM(profiler, GetCurrentProcessId(), "example1.exe");
 
-  {
-    LOG_PERF(profiler, "my_distance1");
+  performance::BenchmarkRunner runner(profiler);
+  constexpr size_t kIterations = 100000000;
+
+  runner.Register("my_distance1", kIterations, [](size_t iterations) {
     size_t x = 0;
     vector<string> names{ "Jerry", "John", "Frank", "Jerry", "John", "Frank",
       "Michael" };
     auto iter_Jerry = find(names.begin(), names.end(), "Jerry");
     auto iter_Michael = find(names.begin(), names.end(), "Michael");
-    for (int i = 0; i < 100000000; ++i) {
+    for (size_t i = 0; i < iterations; ++i) {
       x += my_distance(iter_Jerry, iter_Michael) + i;
     }
-    cout << x << "\n";
-  }
+    return x;
+  });
 
-  {
-    LOG_PERF(profiler, "my_distance2");
+  runner.Register("my_distance2", kIterations, [](size_t iterations) {
     size_t x = 0;
     unordered_map<string, int> names{ { "Jerry", 1 }, { "John", 2 },
       { "Frank", 3 }, { "Frank2", 4 }, { "Frank3", 5 }, { "Frank4", 6 },
@@ -89,36 +142,130 @@ int main() {
     auto iter_Jerry = names.find("Jerry");
     auto iter_Michael = names.find("Michael");
 
-    for (int i = 0; i < 100000000; ++i) {
+    for (size_t i = 0; i < iterations; ++i) {
       x += my_distance(iter_Jerry, iter_Michael) + i;
     }
-    cout << x << "\n";
-  }
+    return x;
+  });
 
-  {
-    LOG_PERF(profiler, "stl distance1");
+  runner.Register("stl distance1", kIterations, [](size_t iterations) {
     size_t x = 0;
     vector<string> names{ "Jerry", "John", "Frank", "Jerry", "John", "Frank",
       "Michael" };
     auto iter_Jerry = find(names.begin(), names.end(), "Jerry");
     auto iter_Michael = find(names.begin(), names.end(), "Michael");
-    for (int i = 0; i < 100000000; ++i) {
+    for (size_t i = 0; i < iterations; ++i) {
       x += std::distance(iter_Jerry, iter_Michael) + i;
     }
-    cout << x << "\n";
-  }
+    return x;
+  });
 
-  {
-    LOG_PERF(profiler, "stl distance2");
+  runner.Register("stl distance2", kIterations, [](size_t iterations) {
     size_t x = 0;
     unordered_map<string, int> names{ { "Jerry", 1 }, { "John", 2 },
       { "Frank", 3 }, { "Frank2", 4 }, { "Frank3", 5 }, { "Frank4", 6 },
       { "Frank5", 7 }, { "Michael", 4 } };
     auto iter_Jerry = names.find("Jerry");
     auto iter_Michael = names.find("Michael");
-    for (int i = 0; i < 100000000; ++i) {
+    for (size_t i = 0; i < iterations; ++i) {
       x += std::distance(iter_Jerry, iter_Michael) + i;
     }
-    cout << x << "\n";
+    return x;
+  });
+
+  constexpr size_t kMapIterations = 10000000;
+  using pool_map_t = interval_map<int, char,
+      util::PoolAllocator<std::pair<const int, char>>>;
+  using arena_map_t = interval_map<int, char,
+      util::ArenaAllocator<std::pair<const int, char>>>;
+
+  runner.Register("interval_map assign", kMapIterations,
+      [](size_t iterations) {
+        interval_map<int, char> map('X');
+        return interval_map_churn(map, iterations);
+      });
+
+  runner.Register("interval_map assign (pool)", kMapIterations,
+      [](size_t iterations) {
+        pool_map_t map('X');
+        return interval_map_churn(map, iterations);
+      });
+
+  // 16 bit keys select the dense interval_map, same workload as above
+  runner.Register("interval_map assign (dense)", kMapIterations,
+      [](size_t iterations) {
+        interval_map<int16_t, char> map('X');
+        return interval_map_churn(map, iterations);
+      });
+
+  runner.Register("interval_map build", kMapIterations,
+      [](size_t iterations) {
+        return interval_map_build<interval_map<int, char>>(iterations);
+      });
+
+  runner.Register("interval_map build (arena)", kMapIterations,
+      [](size_t iterations) {
+        return interval_map_build<arena_map_t>(iterations);
+      });
+
+  // --scaling[=N] runs every scenario at 1, 2, 4 ... N threads, N defaults to
+  // the number of hardware threads.
+  // --pin=CPU pins the measuring thread(s) to CPU, CPU + 1 ...
+  // --high-priority raises the process and thread priority.
+  // --lock-memory[=MB] pre-faults the stack of the measuring thread(s) and
+  // raises the minimum working set by MB for the run (default 64 MB).
+  // --shared-metrics[=NAME] publishes live metrics for perf_top.
+  size_t scaling_threads{};
+  bool scaling{};
+  performance::EnvironmentOptions environment_options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg(argv[i]);
+    if (arg == "--scaling") {
+      scaling = true;
+    } else if (arg.starts_with("--scaling=")) {
+      scaling = true;
+      if (!parse_number(arg.substr(10), scaling_threads)) {
+        std::cerr << "invalid thread count: " << arg << std::endl;
+        print_usage();
+        return 1;
+      }
+    } else if (arg.starts_with("--pin=")) {
+      if (!parse_number(arg.substr(6), environment_options.pin_cpu)) {
+        std::cerr << "invalid CPU: " << arg << std::endl;
+        print_usage();
+        return 1;
+      }
+    } else if (arg == "--high-priority") {
+      environment_options.raise_priority = true;
+    } else if (arg == "--lock-memory") {
+      environment_options.lock_memory_bytes = 64 * 1024 * 1024;
+    } else if (arg.starts_with("--lock-memory=")) {
+      size_t megabytes{};
+      if (!parse_number(arg.substr(14), megabytes)) {
+        std::cerr << "invalid size: " << arg << std::endl;
+        print_usage();
+        return 1;
+      }
+      environment_options.lock_memory_bytes = megabytes * 1024 * 1024;
+    } else if (arg == "--shared-metrics" ||
+               arg.starts_with("--shared-metrics=")) {
+      const std::string name =
+          arg == "--shared-metrics" ? "example1" : std::string(arg.substr(17));
+      if (!profiler->EnableSharedMetrics(name)) {
+        std::cerr << "can't publish metrics to '" << name
+                  << "', is another process using it?" << std::endl;
+        return 1;
+      }
+    } else {
+      std::cerr << "unknown argument: " << arg << std::endl;
+      print_usage();
+      return 1;
+    }
   }
+  runner.SetEnvironmentOptions(environment_options);
+
+  if (scaling)
+    runner.RunScaling(scaling_threads);
+  else
+    runner.Run();
 }
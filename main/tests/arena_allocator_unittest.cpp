@@ -0,0 +1,83 @@
+#include "gtest/gtest.h"
+#include "util/arena_allocator.hpp"
+#include "interval_map.hpp"
+#include "interval_map_churn.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#define GTEST_COUT std::cerr << "[          ] [ INFO ] "
+
+TEST(ArenaAllocator, MonotonicArena) {
+  util::MonotonicArena arena(1024);
+  auto a = arena.Allocate(10, 1);
+  auto b = arena.Allocate(8, 8);
+  EXPECT_NE(a, b);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(b) % 8, 0u);
+  auto large = arena.Allocate(4096, 64);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(large) % 64, 0u);
+  EXPECT_GE(arena.GetReservedBytes(), 1024u + 4096u);
+
+  // An aligned allocation after an oversized block must not overrun it.
+  arena.Allocate(4097, 64);
+  auto aligned = static_cast<char*>(arena.Allocate(8, 64));
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(aligned) % 64, 0u);
+  std::fill(aligned, aligned + 8, '\0');
+
+  arena.Release();
+  EXPECT_EQ(arena.GetReservedBytes(), 0u);
+}
+
+TEST(ArenaAllocator, PoolReuse) {
+  util::PoolResource pool;
+  auto a = pool.Allocate(40, 8);
+  pool.Deallocate(a, 40, 8);
+  // Same size class, the freed memory is reused.
+  auto b = pool.Allocate(48, 8);
+  EXPECT_EQ(a, b);
+  pool.Deallocate(b, 48, 8);
+
+  auto large = pool.Allocate(1024, 8);
+  EXPECT_NE(large, nullptr);
+  pool.Deallocate(large, 1024, 8);
+}
+
+TEST(ArenaAllocator, PoolStableUnderChurn) {
+  util::PoolResource pool;
+  std::vector<void*> nodes;
+  for (int round = 0; round < 100; ++round) {
+    for (int i = 0; i < 1000; ++i)
+      nodes.push_back(pool.Allocate(48, 8));
+    for (auto node : nodes)
+      pool.Deallocate(node, 48, 8);
+    nodes.clear();
+  }
+  EXPECT_LE(pool.GetReservedBytes(), 2 * 1000 * 48u);
+}
+
+TEST(ArenaAllocator, IntervalMapStdAllocator) {
+  interval_map<int, char> map('X');
+  CheckChurn(map, { 'A', 'B', 'C', 'D' });
+}
+
+TEST(ArenaAllocator, IntervalMapPool) {
+  interval_map<int, char, util::PoolAllocator<std::pair<const int, char>>> map(
+      'X');
+  CheckChurn(map, { 'A', 'B', 'C', 'D' });
+  GTEST_COUT << "Pool reserved "
+             << map.get_allocator().GetPool()->GetReservedBytes()
+             << " bytes for " << map.size() << " intervals" << std::endl;
+}
+
+TEST(ArenaAllocator, IntervalMapArena) {
+  auto arena = std::make_shared<util::MonotonicArena>();
+  {
+    interval_map<int, char, util::ArenaAllocator<std::pair<const int, char>>>
+        map('X', util::ArenaAllocator<std::pair<const int, char>>(arena));
+    CheckChurn(map, { 'A', 'B', 'C', 'D' });
+  }
+  // The arena is released in bulk, not per node.
+  EXPECT_GT(arena->GetReservedBytes(), 0u);
+  arena->Release();
+  EXPECT_EQ(arena->GetReservedBytes(), 0u);
+}
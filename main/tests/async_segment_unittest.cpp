@@ -0,0 +1,151 @@
+#include "gtest/gtest.h"
+#include "util/async_segment.hpp"
+#include <future>
+#include <thread>
+#include <chrono>
+
+using namespace std::chrono_literals;
+
+#define GTEST_COUT std::cerr << "[          ] [ INFO ] "
+
+namespace {
+struct FireAndForget {
+  struct promise_type {
+    FireAndForget get_return_object() {
+      return {};
+    }
+    std::suspend_never initial_suspend() noexcept {
+      return {};
+    }
+    std::suspend_never final_suspend() noexcept {
+      return {};
+    }
+    void return_void() {
+    }
+    void unhandled_exception() {
+      std::terminate();
+    }
+  };
+};
+
+// Resumes the awaiting coroutine on a new thread after a delay.
+struct ResumeOnThread {
+  std::chrono::milliseconds delay;
+  std::thread* thread;
+
+  bool await_ready() const noexcept {
+    return false;
+  }
+  void await_suspend(std::coroutine_handle<> handle) {
+    *thread = std::thread([handle, delay = delay]() {
+      std::this_thread::sleep_for(delay);
+      handle.resume();
+    });
+  }
+  int await_resume() const noexcept {
+    return 42;
+  }
+};
+
+struct TaskTimes {
+  double on_cpu{};
+  double suspended{};
+  double total{};
+  int result{};
+  std::vector<performance::AsyncEvent> events;
+};
+
+FireAndForget Handler(std::shared_ptr<performance::PerformanceProfiler> p,
+    std::thread* worker,
+    std::promise<TaskTimes>* done) {
+  performance::AsyncSegment segment(p, "request");
+  TaskTimes times;
+  times.result =
+      co_await performance::Track(segment, ResumeOnThread{ 200ms, worker });
+  segment.End();
+  times.on_cpu = segment.GetOnCpuTime();
+  times.suspended = segment.GetSuspendedTime();
+  times.total = segment.GetTotalTime();
+  times.events = segment.GetEvents();
+  done->set_value(times);
+}
+
+// Declines to suspend in await_suspend.
+struct DeclineSuspend {
+  bool await_ready() const noexcept {
+    return false;
+  }
+  bool await_suspend(std::coroutine_handle<>) const noexcept {
+    return false;
+  }
+  void await_resume() const noexcept {
+  }
+};
+
+FireAndForget Ready(performance::AsyncSegment* segment) {
+  co_await performance::Track(*segment, std::suspend_never{});
+}
+
+FireAndForget Declined(performance::AsyncSegment* segment) {
+  co_await performance::Track(*segment, DeclineSuspend{});
+}
+}  // namespace
+
+TEST(AsyncSegment, SuspendOnOtherThread) {
+  auto profiler = std::make_shared<performance::PerformanceProfiler>(
+      [](const std::string& segment_name, double value,
+          const std::string& unit) {
+        GTEST_COUT << segment_name << " " << value << " " << unit << std::endl;
+      });
+
+  std::thread worker;
+  std::promise<TaskTimes> done;
+  auto future = done.get_future();
+  Handler(profiler, &worker, &done);
+  const auto times = future.get();
+  worker.join();
+
+  EXPECT_EQ(times.result, 42);
+  ASSERT_EQ(times.events.size(), 2u);
+  EXPECT_EQ(times.events[0].type, performance::AsyncEventType::kSuspend);
+  EXPECT_EQ(times.events[1].type, performance::AsyncEventType::kResume);
+  EXPECT_NE(times.events[0].thread, times.events[1].thread);
+  EXPECT_GE(times.suspended, 200 * 1000000.0);
+  EXPECT_LT(times.on_cpu, times.suspended);
+  EXPECT_LE(times.on_cpu + times.suspended, times.total + 1000000.0);
+}
+
+TEST(AsyncSegment, OnCpuExcludesBlocking) {
+  // The task blocks without suspending, i.e. it is running but not on a CPU.
+  performance::AsyncSegment segment(nullptr, "blocking");
+  std::this_thread::sleep_for(100ms);
+  segment.End();
+  EXPECT_GE(segment.GetTotalTime(), 100 * 1000000.0);
+  EXPECT_LT(segment.GetOnCpuTime(), 50 * 1000000.0);
+}
+
+TEST(AsyncSegment, NoSuspend) {
+  performance::AsyncSegment segment(nullptr, "sync");
+  segment.End();
+  EXPECT_TRUE(segment.GetEvents().empty());
+  EXPECT_EQ(segment.GetSuspendedTime(), 0);
+  EXPECT_GE(segment.GetTotalTime(), segment.GetOnCpuTime());
+}
+
+TEST(AsyncSegment, AwaiterReady) {
+  performance::AsyncSegment segment(nullptr, "ready");
+  Ready(&segment);
+  segment.End();
+  EXPECT_TRUE(segment.GetEvents().empty());
+  EXPECT_EQ(segment.GetSuspendedTime(), 0);
+}
+
+TEST(AsyncSegment, SuspendDeclined) {
+  performance::AsyncSegment segment(nullptr, "declined");
+  Declined(&segment);
+  segment.End();
+  ASSERT_EQ(segment.GetEvents().size(), 2u);
+  EXPECT_EQ(segment.GetEvents()[0].type, performance::AsyncEventType::kSuspend);
+  EXPECT_EQ(segment.GetEvents()[1].type, performance::AsyncEventType::kResume);
+  EXPECT_LT(segment.GetSuspendedTime(), 1000000.0);
+}
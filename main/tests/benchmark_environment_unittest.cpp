@@ -0,0 +1,116 @@
+#include "gtest/gtest.h"
+#include "util/benchmark_environment.hpp"
+#include <thread>
+
+#define GTEST_COUT std::cerr << "[          ] [ INFO ] "
+
+TEST(BenchmarkEnvironment, Capture) {
+  const auto snapshot = performance::environment::Capture();
+  GTEST_COUT << snapshot.Describe() << std::endl;
+  for (auto&& warning : snapshot.warnings)
+    GTEST_COUT << "WARNING: " << warning << std::endl;
+
+  EXPECT_GT(snapshot.logical_cpus, 0u);
+  EXPECT_GT(snapshot.physical_cores, 0u);
+  EXPECT_LE(snapshot.physical_cores, snapshot.logical_cpus);
+  EXPECT_EQ(snapshot.pinned_cpu, -1);
+}
+
+TEST(BenchmarkEnvironment, EvaluateSuitable) {
+  performance::EnvironmentSnapshot snapshot{};
+  snapshot.power_scheme = "High performance";
+  snapshot.performance_scheme = true;
+  snapshot.current_mhz = 3000;
+  snapshot.max_mhz = 3000;
+  performance::environment::Evaluate(snapshot);
+  EXPECT_TRUE(snapshot.IsSuitable());
+}
+
+TEST(BenchmarkEnvironment, EvaluateNoisy) {
+  performance::EnvironmentSnapshot snapshot{};
+  snapshot.power_scheme = "Balanced";
+  snapshot.boost_enabled = true;
+  snapshot.smt_enabled = true;
+  snapshot.current_mhz = 1200;
+  snapshot.max_mhz = 3000;
+  performance::environment::Evaluate(snapshot);
+  EXPECT_FALSE(snapshot.IsSuitable());
+  EXPECT_EQ(snapshot.warnings.size(), 4u);
+}
+
+TEST(BenchmarkEnvironment, ApplyPin) {
+  performance::EnvironmentOptions options;
+  options.pin_cpu = 0;
+  // Pin a separate thread, the later tests must not run pinned.
+  performance::EnvironmentSnapshot snapshot;
+  std::thread([&]() {
+    snapshot = performance::environment::Apply(options);
+  }).join();
+  EXPECT_EQ(snapshot.pinned_cpu, 0);
+  EXPECT_FALSE(snapshot.priority_raised);
+  EXPECT_FALSE(snapshot.memory_locked);
+}
+
+TEST(BenchmarkEnvironment, EvaluateFailedOptions) {
+  performance::EnvironmentSnapshot snapshot{};
+  snapshot.power_scheme = "High performance";
+  snapshot.performance_scheme = true;
+  performance::EnvironmentOptions requested;
+  requested.pin_cpu = 2;
+  requested.raise_priority = true;
+  requested.lock_memory_bytes = 1024 * 1024;
+  performance::environment::Evaluate(snapshot, requested);
+  EXPECT_FALSE(snapshot.IsSuitable());
+  EXPECT_EQ(snapshot.warnings.size(), 3u);
+
+  snapshot.pinned_cpu = 2;
+  snapshot.priority_raised = true;
+  snapshot.memory_locked = true;
+  performance::environment::Evaluate(snapshot, requested);
+  EXPECT_TRUE(snapshot.IsSuitable());
+}
+
+TEST(BenchmarkEnvironment, ApplyInvalidPin) {
+  performance::EnvironmentOptions options;
+  options.pin_cpu = 1 << 20;
+  performance::EnvironmentSnapshot snapshot;
+  std::thread([&]() {
+    snapshot = performance::environment::Apply(options);
+  }).join();
+  EXPECT_EQ(snapshot.pinned_cpu, -1);
+  EXPECT_FALSE(snapshot.IsSuitable());
+}
+
+TEST(BenchmarkEnvironment, PinInvalidCpu) {
+  EXPECT_FALSE(performance::environment::PinCurrentThread(1u << 20));
+}
+
+TEST(BenchmarkEnvironment, WorkingSetLock) {
+  {
+    const performance::WorkingSetLock lock(0);
+    EXPECT_FALSE(lock.IsLocked());
+  }
+  size_t minimum{};
+  size_t maximum{};
+  ASSERT_TRUE(performance::environment::GetWorkingSetLimits(minimum, maximum));
+
+  // Consecutive runs restore the limits instead of raising them further.
+  constexpr size_t kBytes = 16 * 1024 * 1024;
+  for (int run = 0; run < 2; ++run) {
+    const performance::WorkingSetLock lock(kBytes);
+    GTEST_COUT << "locked " << lock.IsLocked() << std::endl;
+    size_t locked_minimum{};
+    size_t locked_maximum{};
+    ASSERT_TRUE(performance::environment::GetWorkingSetLimits(
+        locked_minimum, locked_maximum));
+    if (lock.IsLocked())
+      EXPECT_EQ(locked_minimum, minimum + kBytes);
+  }
+
+  size_t restored_minimum{};
+  size_t restored_maximum{};
+  ASSERT_TRUE(performance::environment::GetWorkingSetLimits(
+      restored_minimum, restored_maximum));
+  EXPECT_EQ(restored_minimum, minimum);
+  EXPECT_EQ(restored_maximum, maximum);
+}
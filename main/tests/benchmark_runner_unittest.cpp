@@ -0,0 +1,105 @@
+#include "gtest/gtest.h"
+#include "util/benchmark_runner.hpp"
+#include "util/shared_metrics.hpp"
+#include <atomic>
+#include <unordered_map>
+
+#define GTEST_COUT std::cerr << "[          ] [ INFO ] "
+
+namespace {
+std::shared_ptr<performance::PerformanceProfiler> make_test_profiler() {
+  return std::make_shared<performance::PerformanceProfiler>(
+      [](const std::string& segment_name, double value,
+          const std::string& unit) {
+        GTEST_COUT << segment_name << " " << value << " " << unit << std::endl;
+      });
+}
+}  // namespace
+
+TEST(BenchmarkRunner, ThreadCounts) {
+  EXPECT_EQ(performance::BenchmarkRunner::ThreadCounts(1),
+      std::vector<size_t>({ 1 }));
+  EXPECT_EQ(performance::BenchmarkRunner::ThreadCounts(4),
+      std::vector<size_t>({ 1, 2, 4 }));
+  EXPECT_EQ(performance::BenchmarkRunner::ThreadCounts(6),
+      std::vector<size_t>({ 1, 2, 4, 6 }));
+}
+
+TEST(BenchmarkRunner, Run) {
+  performance::BenchmarkRunner runner(make_test_profiler());
+  runner.Register("sum", 1000, [](size_t iterations) {
+    size_t x = 0;
+    for (size_t i = 0; i < iterations; ++i)
+      x += i;
+    return x;
+  });
+
+  const auto results = runner.Run();
+  ASSERT_EQ(results.size(), 1u);
+  EXPECT_EQ(results[0].threads, 1u);
+  EXPECT_EQ(results[0].checksum, 499500u);
+}
+
+TEST(BenchmarkRunner, RunScaling) {
+  std::atomic<size_t> calls{};
+  performance::BenchmarkRunner runner(make_test_profiler());
+  runner.Register("sum", 100000, [&](size_t iterations) {
+    ++calls;
+    size_t x = 0;
+    for (size_t i = 0; i < iterations; ++i)
+      x += i;
+    return x;
+  });
+
+  const auto results = runner.RunScaling(4);
+  ASSERT_EQ(results.size(), 3u);
+  EXPECT_EQ(calls, 1u + 2u + 4u);
+  for (auto&& result : results) {
+    EXPECT_EQ(result.checksum, result.threads * 4999950000u);
+    EXPECT_GT(result.mean_ns, 0);
+    EXPECT_GT(result.throughput, 0);
+    EXPECT_GE(result.stddev_ns, 0);
+  }
+  EXPECT_DOUBLE_EQ(results[0].efficiency, 1.0);
+}
+
+TEST(BenchmarkRunner, RunScalingFiltered) {
+  // Filtering out every trace segment must not affect the measurement.
+  performance::SegmentFilter::Instance().SetPatterns("-*");
+  performance::BenchmarkRunner runner(make_test_profiler());
+  runner.Register("sum", 100000, [](size_t iterations) {
+    size_t x = 0;
+    for (size_t i = 0; i < iterations; ++i)
+      x += i;
+    return x;
+  });
+
+  const auto results = runner.RunScaling(2);
+  performance::SegmentFilter::Instance().LoadFromEnvironment();
+  ASSERT_EQ(results.size(), 2u);
+  for (auto&& result : results) {
+    EXPECT_GT(result.mean_ns, 0);
+    EXPECT_GT(result.wall_ns, 0);
+  }
+}
+
+TEST(BenchmarkRunner, RunScalingSharedMetrics) {
+  using namespace performance::shared_metrics;
+  const auto region = "example1_unittest_runner_" +
+                      std::to_string(detail::CurrentProcessId());
+  auto profiler = make_test_profiler();
+  ASSERT_TRUE(profiler->EnableSharedMetrics(region));
+  performance::BenchmarkRunner runner(profiler);
+  runner.Register("sum", 1000, [](size_t iterations) { return iterations; });
+  runner.RunScaling(2);
+
+  Reader reader;
+  ASSERT_TRUE(reader.Open(region));
+  Snapshot snapshot;
+  ASSERT_TRUE(reader.Read(snapshot));
+  std::unordered_map<std::string, uint64_t> counts;
+  for (auto&& segment : snapshot.segments)
+    counts[segment.name] = segment.count;
+  EXPECT_EQ(counts["sum x1"], 1u);
+  EXPECT_EQ(counts["sum x2"], 2u);
+}
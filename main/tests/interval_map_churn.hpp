@@ -0,0 +1,57 @@
+/*
+ Interval map test helpers.
+
+ Copyright (c) 2024 Thomas Bruckschlegel. All rights reserved.
+*/
+
+#pragma once
+
+#include "gtest/gtest.h"
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+/**
+ * \brief Apply random assign() churn to an interval map and to a reference
+ * array and compare them, including the canonical size. The ranges begin in
+ * [first, first + keys) and are up to 31 keys long.
+ * \param[in] map the interval map, all keys still mapped to the initial value.
+ * \param[in] values the values to assign.
+ * \param[in] first the first key.
+ * \param[in] keys the number of keys where a range begins.
+ **/
+template<typename Map, typename V = typename Map::mapped_type>
+void CheckChurn(Map& map,
+    std::initializer_list<V> values,
+    int first = 0,
+    int keys = 512) {
+  using key_t = typename Map::key_type;
+  const V initial = map[static_cast<key_t>(first)];
+  std::vector<V> reference(keys + 32, initial);
+  uint32_t seed = 12345;
+  auto next = [&seed](uint32_t range) {
+    seed = seed * 1664525u + 1013904223u;
+    return static_cast<int>((seed >> 8) % range);
+  };
+
+  for (int i = 0; i < 20000; ++i) {
+    const int begin = first + next(keys);
+    const int end = begin + next(32);
+    const V val = values.begin()[next(static_cast<uint32_t>(values.size()))];
+    map.assign(static_cast<key_t>(begin), static_cast<key_t>(end), val);
+    for (int key = begin; key < end; ++key)
+      reference[key - first] = val;
+  }
+
+  // The last reference keys are never assigned, the map ends with initial.
+  size_t intervals = 0;
+  V previous = initial;
+  for (int i = 0; i < keys + 32; ++i) {
+    ASSERT_EQ(map[static_cast<key_t>(first + i)], reference[i])
+        << "key " << first + i;
+    if (!(reference[i] == previous))
+      ++intervals;
+    previous = reference[i];
+  }
+  EXPECT_EQ(map.size(), intervals);
+}
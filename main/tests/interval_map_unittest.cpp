@@ -1,5 +1,8 @@
 #include "gtest/gtest.h"
 #include "interval_map.hpp"
+#include "interval_map_churn.hpp"
+#include <cstdint>
+#include <string>
 
 #define GTEST_COUT std::cerr << "[          ] [ INFO ] "
 
@@ -97,3 +100,85 @@ TEST(IntervalMap, MustFireException_Error) {
   }
   EXPECT_FALSE(exception_fired);
 }
+
+namespace {
+enum class Color : int { kRed, kGreen, kBlue, kCount };
+}  // namespace
+
+template<>
+struct interval_map_domain<Color> {
+  static constexpr bool dense = true;
+  static constexpr long long min = 0;
+  static constexpr long long max = static_cast<long long>(Color::kCount);
+};
+
+TEST(IntervalMap, DenseDomainSelection) {
+  EXPECT_TRUE(interval_map_domain<uint8_t>::dense);
+  EXPECT_TRUE(interval_map_domain<int16_t>::dense);
+  EXPECT_FALSE(interval_map_domain<int>::dense);
+  EXPECT_FALSE(interval_map_domain<std::string>::dense);
+  EXPECT_EQ(interval_map_domain<int8_t>::min, -128);
+  EXPECT_EQ(interval_map_domain<uint16_t>::max, 65535);
+}
+
+TEST(IntervalMap, DenseMatchesTree) {
+  // Same churn on the dense and on the tree based map of a 16 bit key.
+  interval_map<int16_t, char> dense('X');
+  CheckChurn(dense, { 'A', 'B', 'C', 'D' }, -32768, 65536 - 32);
+  interval_map<int16_t, char, std::allocator<std::pair<const int16_t, char>>,
+      false>
+      tree('X');
+  CheckChurn(tree, { 'A', 'B', 'C', 'D' }, -32768, 65536 - 32);
+}
+
+TEST(IntervalMap, DenseAssignList) {
+  using key = uint8_t;
+  interval_map<key, char> map('X');
+  map.assign_list({ { key{ 200 }, 'C' }, { key{ 10 }, 'A' },
+      { key{ 20 }, 'B' } });
+  EXPECT_EQ(map[9], 'X');
+  EXPECT_EQ(map[10], 'A');
+  EXPECT_EQ(map[19], 'A');
+  EXPECT_EQ(map[20], 'B');
+  EXPECT_EQ(map[199], 'B');
+  EXPECT_EQ(map[255], 'C');
+  EXPECT_EQ(map.size(), 3u);
+
+  EXPECT_THROW(map.assign_list({ { key{ 1 }, 'X' } }), std::invalid_argument);
+  EXPECT_THROW(map.assign_list({ { key{ 1 }, 'A' }, { key{ 2 }, 'A' } }),
+      std::invalid_argument);
+  EXPECT_THROW(map.assign_list({ { key{ 1 }, 'A' }, { key{ 1 }, 'B' } }),
+      std::invalid_argument);
+  // A rejected list leaves the map unchanged.
+  EXPECT_EQ(map[10], 'A');
+  EXPECT_EQ(map.size(), 3u);
+}
+
+TEST(IntervalMap, DenseCustomDomain) {
+  interval_map<Color, int> map(0);
+  map.assign(Color::kGreen, Color::kCount, 7);
+  map.assign(Color::kBlue, Color::kRed, 9);
+  EXPECT_EQ(map[Color::kRed], 0);
+  EXPECT_EQ(map[Color::kGreen], 7);
+  EXPECT_EQ(map[Color::kBlue], 7);
+  EXPECT_EQ(map[Color::kCount], 0);
+  EXPECT_EQ(map.size(), 2u);
+}
+
+TEST(IntervalMap, DenseBoolValues) {
+  interval_map<uint8_t, bool> map(false);
+  map.assign(3, 10, true);
+  map.assign(5, 7, false);
+  EXPECT_FALSE(map[2]);
+  EXPECT_TRUE(map[3]);
+  EXPECT_TRUE(map[4]);
+  EXPECT_FALSE(map[5]);
+  EXPECT_FALSE(map[6]);
+  EXPECT_TRUE(map[7]);
+  EXPECT_TRUE(map[9]);
+  EXPECT_FALSE(map[10]);
+  EXPECT_EQ(map.size(), 4u);
+
+  interval_map<uint8_t, bool> churn(false);
+  CheckChurn(churn, { false, true }, 0, 256 - 32);
+}
@@ -44,3 +44,65 @@ TEST(PerformanceProfiler, Start) {
 TEST(PerformanceProfiler, End) {
   test.reset();
 }
+
+TEST(PerformanceProfiler, Calibrate) {
+  performance::PerformanceProfiler profiler(
+      [](const std::string&, double, const std::string&) {});
+  const auto overhead = profiler.Calibrate();
+  GTEST_COUT << "Profiler overhead " << overhead << " ns" << std::endl;
+  EXPECT_GT(overhead, 0);
+  EXPECT_DOUBLE_EQ(profiler.GetOverhead(), overhead);
+}
+
+TEST(PerformanceProfiler, NestedCorrected) {
+  std::unordered_map<std::string, double> values;
+  auto profiler = std::make_shared<performance::PerformanceProfiler>(
+      [&](const std::string& segment_name, double value,
+          const std::string& unit) {
+        if (unit == "ns")
+          values[segment_name] = value;
+      });
+
+  {
+    LOG_PERF(profiler, "outer");
+    for (int i = 0; i < 10; ++i) {
+      LOG_PERF(profiler, "inner");
+    }
+  }
+
+  ASSERT_EQ(values.count("outer"), 1u);
+  ASSERT_EQ(values.count("outer (corrected)"), 1u);
+  ASSERT_EQ(values.count("inner (corrected)"), 1u);
+  GTEST_COUT << "outer raw " << values["outer"] << " ns, corrected "
+             << values["outer (corrected)"] << " ns" << std::endl;
+  EXPECT_GE(values["outer (corrected)"], 0);
+  EXPECT_LT(values["outer (corrected)"], values["outer"]);
+  EXPECT_LE(values["inner (corrected)"], values["inner"]);
+}
+
+TEST(PerformanceProfiler, EmptyChildrenCorrected) {
+  std::unordered_map<std::string, double> values;
+  auto profiler = std::make_shared<performance::PerformanceProfiler>(
+      [&](const std::string& segment_name, double value,
+          const std::string& unit) {
+        if (unit == "ns")
+          values[segment_name] = value;
+      });
+  profiler->SetCalibrationInterval(std::chrono::milliseconds(0));
+
+  // The outer segment only holds the cost of its children, which is all
+  // profiler overhead.
+  constexpr int kChildren = 1000;
+  {
+    LOG_PERF(profiler, "outer");
+    for (int i = 0; i < kChildren; ++i) {
+      LOG_PERF(profiler, "empty");
+    }
+  }
+
+  ASSERT_EQ(values.count("outer (corrected)"), 1u);
+  const auto corrected = values["outer (corrected)"];
+  GTEST_COUT << "outer raw " << values["outer"] << " ns, corrected "
+             << corrected << " ns" << std::endl;
+  EXPECT_LT(corrected, 0.1 * values["outer"]);
+}
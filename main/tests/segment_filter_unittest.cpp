@@ -0,0 +1,104 @@
+#include "gtest/gtest.h"
+#include "util/segment_filter.hpp"
+#include "util/perf_macros.h"
+#include <cstdio>
+#include <fstream>
+
+#define GTEST_COUT std::cerr << "[          ] [ INFO ] "
+
+using performance::SegmentFilter;
+
+namespace {
+std::vector<std::string> RunSegments(
+    std::shared_ptr<performance::PerformanceProfiler>& profiler,
+    std::vector<std::string>& output) {
+  output.clear();
+  { LOG_PERF(profiler, "net.read"); }
+  { LOG_PERF(profiler, "net.poll"); }
+  { LOG_PERF(profiler, "db.query"); }
+  { LOG_PERF_DYNAMIC(profiler, std::string("db.") + "commit"); }
+  return output;
+}
+}  // namespace
+
+TEST(SegmentFilter, Match) {
+  EXPECT_TRUE(SegmentFilter::Match("*", ""));
+  EXPECT_TRUE(SegmentFilter::Match("*", "anything"));
+  EXPECT_TRUE(SegmentFilter::Match("net.*", "net.read"));
+  EXPECT_TRUE(SegmentFilter::Match("*.poll", "net.poll"));
+  EXPECT_TRUE(SegmentFilter::Match("n?t.*d", "net.read"));
+  EXPECT_TRUE(SegmentFilter::Match("a*b*c", "aXXbYYbZc"));
+  EXPECT_FALSE(SegmentFilter::Match("net.*", "db.query"));
+  EXPECT_FALSE(SegmentFilter::Match("net", "net.read"));
+  EXPECT_FALSE(SegmentFilter::Match("a*b*c", "aXXbYYbZ"));
+  EXPECT_FALSE(SegmentFilter::Match("?", ""));
+}
+
+TEST(SegmentFilter, Patterns) {
+  auto& filter = SegmentFilter::Instance();
+  filter.SetPatterns("");
+  EXPECT_TRUE(filter.IsEnabled("net.read"));
+
+  filter.SetPatterns("net.*, -*.poll");
+  EXPECT_TRUE(filter.IsEnabled("net.read"));
+  EXPECT_FALSE(filter.IsEnabled("net.poll"));
+  EXPECT_FALSE(filter.IsEnabled("db.query"));
+
+  filter.SetPatterns("-*");
+  EXPECT_FALSE(filter.IsEnabled("net.read"));
+  filter.SetPatterns("");
+}
+
+TEST(SegmentFilter, Handles) {
+  auto& filter = SegmentFilter::Instance();
+  std::vector<std::string> output;
+  auto profiler = std::make_shared<performance::PerformanceProfiler>(
+      [&](const std::string& segment_name, double, const std::string& unit) {
+        if (unit == "ns" && segment_name.find('(') == std::string::npos)
+          output.push_back(segment_name);
+      });
+
+  filter.SetPatterns("");
+  EXPECT_EQ(RunSegments(profiler, output),
+      std::vector<std::string>({ "net.read", "net.poll", "db.query",
+          "db.commit" }));
+
+  // The handles of the call sites above are re-resolved.
+  filter.SetPatterns("net.*;-*.poll");
+  EXPECT_EQ(RunSegments(profiler, output),
+      std::vector<std::string>({ "net.read" }));
+
+  filter.SetPatterns("db.*");
+  EXPECT_EQ(RunSegments(profiler, output),
+      std::vector<std::string>({ "db.query", "db.commit" }));
+
+  filter.SetPatterns("");
+}
+
+TEST(SegmentFilter, LoadFromFile) {
+  const std::string path = "segment_filter_unittest.txt";
+  {
+    std::ofstream file(path);
+    file << "# debug the network\nnet.*\n-*.poll  # too noisy\n";
+  }
+
+  performance::SegmentHandle read("net.read");
+  performance::SegmentHandle poll("net.poll");
+  auto& filter = SegmentFilter::Instance();
+  ASSERT_TRUE(filter.LoadFromFile(path));
+  EXPECT_TRUE(read.IsEnabled());
+  EXPECT_FALSE(poll.IsEnabled());
+
+  {
+    std::ofstream file(path);
+    file << "*.poll\n";
+  }
+  filter.Reload();
+  EXPECT_FALSE(read.IsEnabled());
+  EXPECT_TRUE(poll.IsEnabled());
+
+  std::remove(path.c_str());
+  EXPECT_FALSE(filter.LoadFromFile(path));
+  filter.SetPatterns("");
+  EXPECT_TRUE(read.IsEnabled());
+}
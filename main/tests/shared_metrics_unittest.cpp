@@ -0,0 +1,173 @@
+#include "gtest/gtest.h"
+#include "util/shared_metrics.hpp"
+#include "util/performance_profiler.hpp"
+#include "util/perf_macros.h"
+#include <thread>
+
+#define GTEST_COUT std::cerr << "[          ] [ INFO ] "
+
+using namespace performance::shared_metrics;
+
+namespace {
+// Region names are unique per process, so that concurrent test runs don't
+// share a region.
+std::string RegionName(const std::string& name) {
+  return "example1_unittest_" + name + "_" +
+         std::to_string(detail::CurrentProcessId());
+}
+}  // namespace
+
+TEST(SharedMetrics, OpenMissingRegion) {
+  Reader reader;
+  EXPECT_FALSE(reader.Open(RegionName("missing")));
+  Snapshot snapshot;
+  EXPECT_FALSE(reader.Read(snapshot));
+}
+
+TEST(SharedMetrics, WriteAndRead) {
+  Writer writer(RegionName("metrics"));
+  ASSERT_TRUE(writer.IsOpen());
+  for (int i = 1; i <= 100; ++i)
+    writer.Record("segment", i * 1000.0);
+  writer.Record("other", 5);
+
+  Reader reader;
+  ASSERT_TRUE(reader.Open(RegionName("metrics")));
+  Snapshot snapshot;
+  ASSERT_TRUE(reader.Read(snapshot));
+  ASSERT_EQ(snapshot.segments.size(), 2u);
+
+  const auto& segment = snapshot.segments[0];
+  EXPECT_EQ(segment.name, "segment");
+  EXPECT_EQ(segment.count, 100u);
+  EXPECT_EQ(segment.total_ns, 5050000u);
+  EXPECT_EQ(segment.min_ns, 1000u);
+  EXPECT_EQ(segment.max_ns, 100000u);
+  EXPECT_EQ(segment.last_ns, 100000u);
+
+  // Histogram buckets are powers of two, allow a factor of two.
+  const auto p50 = segment.Percentile(50);
+  GTEST_COUT << "p50 " << p50 << " ns" << std::endl;
+  EXPECT_GE(p50, 25000);
+  EXPECT_LE(p50, 100000);
+  EXPECT_LE(segment.Percentile(50), segment.Percentile(99));
+  EXPECT_EQ(segment.Percentile(100), 100000);
+
+  EXPECT_EQ(snapshot.segments[1].name, "other");
+  EXPECT_EQ(snapshot.segments[1].count, 1u);
+}
+
+TEST(SharedMetrics, ConcurrentRead) {
+  Writer writer(RegionName("concurrent"));
+  ASSERT_TRUE(writer.IsOpen());
+  writer.Record("segment", 1);
+
+  Reader reader;
+  ASSERT_TRUE(reader.Open(RegionName("concurrent")));
+
+  std::thread producer([&]() {
+    for (int i = 0; i < 100000; ++i)
+      writer.Record("segment", 1);
+  });
+
+  // Every snapshot must be consistent, i.e. the histogram adds up.
+  Snapshot snapshot;
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_TRUE(reader.Read(snapshot));
+    uint64_t histogram_count{};
+    for (auto&& bucket : snapshot.segments[0].histogram)
+      histogram_count += bucket;
+    EXPECT_EQ(histogram_count, snapshot.segments[0].count);
+    EXPECT_EQ(snapshot.segments[0].total_ns, snapshot.segments[0].count);
+  }
+  producer.join();
+}
+
+TEST(SharedMetrics, Profiler) {
+  auto profiler = std::make_shared<performance::PerformanceProfiler>(
+      [](const std::string&, double, const std::string&) {});
+  ASSERT_TRUE(profiler->EnableSharedMetrics(RegionName("profiler")));
+  for (int i = 0; i < 3; ++i) {
+    LOG_PERF(profiler, "unit test");
+  }
+
+  Reader reader;
+  ASSERT_TRUE(reader.Open(RegionName("profiler")));
+  Snapshot snapshot;
+  ASSERT_TRUE(reader.Read(snapshot));
+  ASSERT_EQ(snapshot.segments.size(), 1u);
+  EXPECT_EQ(snapshot.segments[0].name, "unit test");
+  EXPECT_EQ(snapshot.segments[0].count, 3u);
+}
+
+TEST(SharedMetrics, SecondWriterRejected) {
+  Writer writer(RegionName("second"));
+  ASSERT_TRUE(writer.IsOpen());
+  Writer second(RegionName("second"));
+  EXPECT_FALSE(second.IsOpen());
+}
+
+TEST(SharedMetrics, TakeOverRegion) {
+  // The reader keeps the region of the first producer alive.
+  Reader reader;
+  {
+    Writer writer(RegionName("takeover"));
+    ASSERT_TRUE(writer.IsOpen());
+    for (int i = 0; i < 10; ++i)
+      writer.Record("old", 1000);
+    ASSERT_TRUE(reader.Open(RegionName("takeover")));
+  }
+
+  Writer writer(RegionName("takeover"));
+  ASSERT_TRUE(writer.IsOpen());
+  writer.Record("new", 5);
+
+  Snapshot snapshot;
+  ASSERT_TRUE(reader.Read(snapshot));
+  ASSERT_EQ(snapshot.segments.size(), 1u);
+  EXPECT_EQ(snapshot.segments[0].name, "new");
+  EXPECT_EQ(snapshot.segments[0].count, 1u);
+  EXPECT_EQ(snapshot.segments[0].total_ns, 5u);
+  EXPECT_EQ(snapshot.segments[0].max_ns, 5u);
+  uint64_t histogram_count{};
+  for (auto&& bucket : snapshot.segments[0].histogram)
+    histogram_count += bucket;
+  EXPECT_EQ(histogram_count, 1u);
+}
+
+TEST(SharedMetrics, TakeOverInterruptedRegion) {
+  Reader reader;
+  {
+    Writer writer(RegionName("interrupted"));
+    ASSERT_TRUE(writer.IsOpen());
+    writer.Record("old", 1000);
+    ASSERT_TRUE(reader.Open(RegionName("interrupted")));
+  }
+
+  // A producer that died in the middle of an update leaves the sequence
+  // numbers odd, readers give up instead of hanging.
+  {
+    detail::SharedMemory memory;
+    ASSERT_TRUE(detail::CreateSharedMemory(
+        RegionName("interrupted"), sizeof(Region), memory));
+    auto region = static_cast<Region*>(memory.view);
+    region->memory_sequence.fetch_add(1);
+    region->slots[0].sequence.fetch_add(1);
+    Snapshot snapshot;
+    EXPECT_FALSE(reader.Read(snapshot));
+    detail::CloseSharedMemory(memory);
+  }
+
+  Writer writer(RegionName("interrupted"));
+  ASSERT_TRUE(writer.IsOpen());
+  writer.Record("new", 5);
+  writer.RecordMemory(detail::CurrentProcessId(), 10, 20);
+
+  Snapshot snapshot;
+  ASSERT_TRUE(reader.Read(snapshot));
+  ASSERT_EQ(snapshot.segments.size(), 1u);
+  EXPECT_EQ(snapshot.segments[0].name, "new");
+  EXPECT_EQ(snapshot.segments[0].count, 1u);
+  EXPECT_EQ(snapshot.private_mb, 10u);
+  EXPECT_EQ(snapshot.peak_mb, 20u);
+}
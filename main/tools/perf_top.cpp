@@ -0,0 +1,108 @@
+/*
+ perf_top - shows the live profiler metrics of a running process.
+
+ Copyright (c) 2024 Thomas Bruckschlegel. All rights reserved.
+*/
+
+#include "util/shared_metrics.hpp"
+#include <charconv>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <Windows.h>
+
+using namespace performance::shared_metrics;
+
+// usage: perf_top <region name> [refresh interval in ms]
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "usage: perf_top <region name> [interval ms]" << std::endl;
+    return 1;
+  }
+
+  const std::string name = argv[1];
+  uint32_t interval_ms = 1000;
+  if (argc > 2) {
+    const std::string_view text(argv[2]);
+    const auto end = text.data() + text.size();
+    const auto [ptr, error] = std::from_chars(text.data(), end, interval_ms);
+    if (error != std::errc() || ptr != end || interval_ms == 0) {
+      std::cerr << "invalid interval: " << text << std::endl;
+      return 1;
+    }
+  }
+  const auto interval = std::chrono::milliseconds(interval_ms);
+
+  Reader reader;
+  if (!reader.Open(name)) {
+    std::cerr << "Can't attach to '" << name << "'" << std::endl;
+    return 1;
+  }
+
+  // Allow ANSI escape sequences to redraw the screen.
+  auto console = GetStdHandle(STD_OUTPUT_HANDLE);
+  DWORD mode{};
+  if (GetConsoleMode(console, &mode))
+    SetConsoleMode(console, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+
+  std::unordered_map<std::string, uint64_t> last_counts;
+  auto last_time = std::chrono::steady_clock::now();
+  Snapshot snapshot;
+  for (;;) {
+    if (!reader.Read(snapshot)) {
+      std::cerr << "The producer stopped in the middle of an update"
+                << std::endl;
+      return 1;
+    }
+    // The writer clears the pid when it detaches, the data won't change.
+    if (snapshot.pid == 0) {
+      std::cout << name << " - the producer has detached" << std::endl;
+      return 0;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    const double seconds =
+        std::chrono::duration<double>(now - last_time).count();
+    last_time = now;
+
+    std::cout << "\x1b[2J\x1b[H";
+    std::cout << name << " - pid " << snapshot.pid << " - memory "
+              << snapshot.private_mb << " MB (peak " << snapshot.peak_mb
+              << " MB)" << std::endl
+              << std::endl;
+    std::cout << std::left << std::setw(40) << "Segment" << std::right
+              << std::setw(12) << "Count" << std::setw(12) << "Rate/s"
+              << std::setw(14) << "Mean ns" << std::setw(14) << "p50 ns"
+              << std::setw(14) << "p90 ns" << std::setw(14) << "p99 ns"
+              << std::setw(14) << "Max ns" << std::endl;
+
+    for (auto&& segment : snapshot.segments) {
+      auto& last_count = last_counts[segment.name];
+      const double rate = seconds > 0 && last_count > 0
+                              ? static_cast<double>(segment.count - last_count) /
+                                    seconds
+                              : 0;
+      last_count = segment.count;
+      const double mean =
+          segment.count > 0
+              ? static_cast<double>(segment.total_ns) /
+                    static_cast<double>(segment.count)
+              : 0;
+
+      std::cout << std::left << std::setw(40) << segment.name.substr(0, 39)
+                << std::right << std::fixed << std::setprecision(0)
+                << std::setw(12) << segment.count << std::setw(12) << rate
+                << std::setw(14) << mean << std::setw(14)
+                << segment.Percentile(50) << std::setw(14)
+                << segment.Percentile(90) << std::setw(14)
+                << segment.Percentile(99) << std::setw(14) << segment.max_ns
+                << std::endl;
+    }
+
+    std::this_thread::sleep_for(interval);
+  }
+}
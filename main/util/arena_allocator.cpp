@@ -0,0 +1,96 @@
+/*
+ Arena and pool allocators for node based containers.
+
+ Copyright (c) 2024 Thomas Bruckschlegel. All rights reserved.
+*/
+
+#include "arena_allocator.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+namespace util {
+namespace {
+constexpr size_t RoundUp(size_t size, size_t alignment) {
+  return (size + alignment - 1) / alignment * alignment;
+}
+
+char* AlignUp(char* p, size_t alignment) {
+  const auto address = reinterpret_cast<uintptr_t>(p);
+  return p + ((alignment - address % alignment) % alignment);
+}
+}  // namespace
+
+MonotonicArena::MonotonicArena(size_t block_size) : block_size_(block_size) {
+}
+
+MonotonicArena::~MonotonicArena() {
+  Release();
+}
+
+void* MonotonicArena::Allocate(size_t size, size_t alignment) {
+  char* p = current_ != nullptr ? AlignUp(current_, alignment) : nullptr;
+  // Aligning can move p past the end of the block.
+  if (p == nullptr || p > end_ || size > static_cast<size_t>(end_ - p)) {
+    // The block header is followed by the allocations.
+    constexpr size_t header = RoundUp(sizeof(Block), alignof(std::max_align_t));
+    const size_t size_needed = RoundUp(header + size + alignment, alignment);
+    const size_t block_size = (std::max)(block_size_, size_needed);
+    auto block = static_cast<Block*>(::operator new(block_size));
+    block->next = blocks_;
+    block->size = block_size;
+    blocks_ = block;
+    reserved_ += block_size;
+
+    current_ = reinterpret_cast<char*>(block) + header;
+    end_ = reinterpret_cast<char*>(block) + block_size;
+    p = AlignUp(current_, alignment);
+  }
+
+  current_ = p + size;
+  return p;
+}
+
+void MonotonicArena::Release() {
+  while (blocks_ != nullptr) {
+    auto next = blocks_->next;
+    ::operator delete(blocks_);
+    blocks_ = next;
+  }
+  current_ = nullptr;
+  end_ = nullptr;
+  reserved_ = 0;
+}
+
+PoolResource::PoolResource(size_t block_size) : arena_(block_size) {
+}
+
+void* PoolResource::Allocate(size_t size, size_t alignment) {
+  size = (std::max)(size, size_t{ 1 });
+  if (!IsPooled(size, alignment))
+    return ::operator new(size, std::align_val_t(alignment));
+
+  const auto size_class = GetSizeClass(size);
+  if (auto node = free_lists_[size_class]; node != nullptr) {
+    free_lists_[size_class] = node->next;
+    return node;
+  }
+  return arena_.Allocate((size_class + 1) * kGranularity, kGranularity);
+}
+
+void PoolResource::Deallocate(void* p, size_t size, size_t alignment) {
+  size = (std::max)(size, size_t{ 1 });
+  if (!IsPooled(size, alignment)) {
+    ::operator delete(p, size, std::align_val_t(alignment));
+    return;
+  }
+
+  auto& free_list = free_lists_[GetSizeClass(size)];
+  free_list = new (p) FreeNode{ free_list };
+}
+
+void PoolResource::Release() {
+  arena_.Release();
+  std::fill(std::begin(free_lists_), std::end(free_lists_), nullptr);
+}
+}  // namespace util
@@ -0,0 +1,194 @@
+/*
+ Arena and pool allocators for node based containers.
+
+ Copyright (c) 2024 Thomas Bruckschlegel. All rights reserved.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+namespace util {
+/**
+ * \brief Hands out memory from large blocks and frees the blocks all at once,
+ * individual deallocations are ignored. Suited to containers that are built
+ * and then discarded as a whole. Not thread safe.
+ **/
+class MonotonicArena final {
+public:
+  static constexpr size_t kDefaultBlockSize = 64 * 1024;
+
+  explicit MonotonicArena(size_t block_size = kDefaultBlockSize);
+  MonotonicArena(const MonotonicArena&) = delete;
+  MonotonicArena& operator=(const MonotonicArena&) = delete;
+  ~MonotonicArena();
+
+  /**
+   * \brief Allocate memory from the current block, a new block is added when
+   * it doesn't fit.
+   * \param[in] size the size in bytes.
+   * \param[in] alignment the alignment, a power of two.
+   * \return the memory.
+   **/
+  void* Allocate(size_t size, size_t alignment);
+
+  /**
+   * \brief Free all blocks at once.
+   **/
+  void Release();
+
+  /**
+   * \brief Get the memory held by the arena.
+   * \return the size of all blocks in bytes.
+   **/
+  size_t GetReservedBytes() const {
+    return reserved_;
+  }
+
+private:
+  struct Block {
+    Block* next;
+    size_t size;
+  };
+
+  size_t block_size_;
+  Block* blocks_{};
+  char* current_{};
+  char* end_{};
+  size_t reserved_{};
+};
+
+/**
+ * \brief Size-class pool: small allocations are rounded up to a multiple of
+ * 16 bytes and recycled through one free list per size class, so that steady
+ * insert/erase churn reuses the same memory instead of going through
+ * malloc/free. The memory comes from a MonotonicArena and is freed all at
+ * once. Larger allocations go to operator new. Not thread safe.
+ **/
+class PoolResource final {
+public:
+  static constexpr size_t kGranularity = 16;
+  static constexpr size_t kMaxPooledSize = 256;
+
+  explicit PoolResource(size_t block_size = MonotonicArena::kDefaultBlockSize);
+  PoolResource(const PoolResource&) = delete;
+  PoolResource& operator=(const PoolResource&) = delete;
+  ~PoolResource() = default;
+
+  void* Allocate(size_t size, size_t alignment);
+  void Deallocate(void* p, size_t size, size_t alignment);
+
+  /**
+   * \brief Free all memory at once, outstanding allocations become invalid.
+   **/
+  void Release();
+
+  /**
+   * \brief Get the memory held by the pool, not counting large allocations.
+   * \return the size of all blocks in bytes.
+   **/
+  size_t GetReservedBytes() const {
+    return arena_.GetReservedBytes();
+  }
+
+private:
+  struct FreeNode {
+    FreeNode* next;
+  };
+
+  static constexpr size_t kSizeClasses = kMaxPooledSize / kGranularity;
+
+  static bool IsPooled(size_t size, size_t alignment) {
+    return size <= kMaxPooledSize && alignment <= kGranularity;
+  }
+  static size_t GetSizeClass(size_t size) {
+    return (size + kGranularity - 1) / kGranularity - 1;
+  }
+
+  MonotonicArena arena_;
+  FreeNode* free_lists_[kSizeClasses]{};
+};
+
+/**
+ * \brief Standard allocator on top of a shared MonotonicArena. Copies and
+ * rebinds share the arena, it is freed when the last of them is destroyed,
+ * e.g. together with the container.
+ **/
+template<typename T>
+class ArenaAllocator {
+public:
+  using value_type = T;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  ArenaAllocator() : arena_(std::make_shared<MonotonicArena>()) {
+  }
+  explicit ArenaAllocator(std::shared_ptr<MonotonicArena> arena)
+      : arena_(std::move(arena)) {
+  }
+  template<typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.GetArena()) {
+  }
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(arena_->Allocate(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T*, size_t) {
+  }
+
+  const std::shared_ptr<MonotonicArena>& GetArena() const {
+    return arena_;
+  }
+
+  template<typename U>
+  bool operator==(const ArenaAllocator<U>& other) const {
+    return arena_ == other.GetArena();
+  }
+
+private:
+  std::shared_ptr<MonotonicArena> arena_;
+};
+
+/**
+ * \brief Standard allocator on top of a shared PoolResource. Copies and
+ * rebinds share the pool, it is freed when the last of them is destroyed,
+ * e.g. together with the container.
+ **/
+template<typename T>
+class PoolAllocator {
+public:
+  using value_type = T;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  PoolAllocator() : pool_(std::make_shared<PoolResource>()) {
+  }
+  explicit PoolAllocator(std::shared_ptr<PoolResource> pool)
+      : pool_(std::move(pool)) {
+  }
+  template<typename U>
+  PoolAllocator(const PoolAllocator<U>& other) : pool_(other.GetPool()) {
+  }
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(pool_->Allocate(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T* p, size_t n) {
+    pool_->Deallocate(p, n * sizeof(T), alignof(T));
+  }
+
+  const std::shared_ptr<PoolResource>& GetPool() const {
+    return pool_;
+  }
+
+  template<typename U>
+  bool operator==(const PoolAllocator<U>& other) const {
+    return pool_ == other.GetPool();
+  }
+
+private:
+  std::shared_ptr<PoolResource> pool_;
+};
+}  // namespace util
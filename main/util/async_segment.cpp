@@ -0,0 +1,85 @@
+/*
+ Performance profiler - segments of asynchronous tasks.
+
+ Copyright (c) 2024 Thomas Bruckschlegel. All rights reserved.
+*/
+
+#include "async_segment.hpp"
+#include <atomic>
+#include <sstream>
+
+namespace performance {
+namespace {
+std::atomic<uint64_t> next_task_id{ 1 };
+
+std::string ToString(std::thread::id thread) {
+  std::ostringstream out;
+  out << thread;
+  return out.str();
+}
+}  // namespace
+
+AsyncSegment::AsyncSegment(std::shared_ptr<PerformanceProfiler> profiler,
+    const std::string& segment_name)
+    : profiler_(profiler)
+    , segment_name_(segment_name)
+    , task_id_(next_task_id++)
+    , running_since_ns_(detail::CurrentThreadCpuTime()) {
+}
+
+AsyncSegment::~AsyncSegment() {
+  End();
+}
+
+void AsyncSegment::Suspend() {
+  if (running_) {
+    on_cpu_ns_ += detail::CurrentThreadCpuTime() - running_since_ns_;
+    running_ = false;
+  }
+  suspended_timer_.Resume();
+  events_.push_back(AsyncEvent{ AsyncEventType::kSuspend,
+      std::this_thread::get_id(), total_timer_.ElapsedTime() });
+}
+
+void AsyncSegment::Resume() {
+  suspended_timer_.Pause();
+  running_since_ns_ = detail::CurrentThreadCpuTime();
+  running_ = true;
+  events_.push_back(AsyncEvent{ AsyncEventType::kResume,
+      std::this_thread::get_id(), total_timer_.ElapsedTime() });
+}
+
+void AsyncSegment::End() {
+  if (ended_)
+    return;
+
+  if (running_) {
+    on_cpu_ns_ += detail::CurrentThreadCpuTime() - running_since_ns_;
+    running_ = false;
+  } else {
+    suspended_timer_.Pause();
+  }
+  total_ns_ = total_timer_.ElapsedTime();
+  ended_ = true;
+
+  if (profiler_ == nullptr)
+    return;
+
+  const auto task = segment_name_ + "#" + std::to_string(task_id_);
+  for (size_t i = 1; i < events_.size(); ++i) {
+    const auto& suspend = events_[i - 1];
+    const auto& resume = events_[i];
+    if (suspend.type == AsyncEventType::kSuspend &&
+        resume.type == AsyncEventType::kResume &&
+        suspend.thread != resume.thread)
+      profiler_->SendComment(task + " flow thread " + ToString(suspend.thread) +
+                             " -> thread " + ToString(resume.thread));
+  }
+
+  profiler_->SendValue(
+      segment_name_ + " (on-cpu)", GetOnCpuTime(), ProfilerUnit::kNS);
+  profiler_->SendValue(
+      segment_name_ + " (suspended)", GetSuspendedTime(), ProfilerUnit::kNS);
+  profiler_->SendValue(segment_name_ + " (total)", total_ns_, ProfilerUnit::kNS);
+}
+}  // namespace performance
@@ -0,0 +1,198 @@
+/*
+ Performance profiler - segments of asynchronous tasks.
+
+ Copyright (c) 2024 Thomas Bruckschlegel. All rights reserved.
+*/
+
+#pragma once
+
+#include "util/performance_profiler.hpp"
+#include <coroutine>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace performance {
+/// Events recorded by an AsyncSegment.
+enum class AsyncEventType {
+  kSuspend,  /// the task suspended
+  kResume    /// the task resumed
+};
+
+struct AsyncEvent {
+  AsyncEventType type{};
+  std::thread::id thread;
+  double offset_ns{};  /// time since the segment was created
+};
+
+namespace detail {
+/**
+ * @brief Get the CPU time (user and kernel) consumed by the calling thread.
+ * @return the CPU time in nanoseconds.
+ */
+double CurrentThreadCpuTime();
+}  // namespace detail
+
+/**
+ * A segment of a logical task, e.g. a coroutine, that may suspend and resume
+ * on different threads. Unlike PerformanceObject it separates the CPU time
+ * of the threads while they run the task (on-CPU), the time it is suspended
+ * (waiting or queued for a thread) and the total latency. The remainder of
+ * the total is time the running task was preempted. The task must be running
+ * on at most one thread at a time.
+ */
+class AsyncSegment final {
+public:
+  AsyncSegment() = delete;
+  AsyncSegment(const AsyncSegment&) = delete;
+  AsyncSegment& operator=(const AsyncSegment&) = delete;
+
+  /**
+   * @brief Start tracking a logical task, the task is running on the calling
+   * thread.
+   * @param profiler the performance profiler the times are reported to.
+   * @param segment_name the segment name.
+   */
+  explicit AsyncSegment(std::shared_ptr<PerformanceProfiler> profiler,
+      const std::string& segment_name);
+
+  /**
+   * @brief Ends the segment if End() wasn't called yet.
+   */
+  ~AsyncSegment();
+
+  /**
+   * @brief Record that the task is about to suspend, on the thread that ran
+   * it.
+   */
+  void Suspend();
+
+  /**
+   * @brief Record that the task resumed on the calling thread.
+   */
+  void Resume();
+
+  /**
+   * @brief Stop tracking and output the on-CPU, suspended and total time as
+   * well as a flow link for every resume on a different thread.
+   */
+  void End();
+
+  /**
+   * @brief Get the CPU time the task consumed up to the last Suspend() or
+   * End().
+   * @return the on-CPU time in nanoseconds.
+   */
+  double GetOnCpuTime() const {
+    return on_cpu_ns_;
+  }
+
+  /**
+   * @brief Get the time the task was suspended.
+   * @return the suspended time in nanoseconds.
+   */
+  double GetSuspendedTime() const {
+    return suspended_timer_.ElapsedTime();
+  }
+
+  /**
+   * @brief Get the total latency of the task.
+   * @return the total time in nanoseconds.
+   */
+  double GetTotalTime() const {
+    return ended_ ? total_ns_ : total_timer_.ElapsedTime();
+  }
+
+  /**
+   * @brief Get the recorded suspend and resume events.
+   * @return the events in order.
+   */
+  const std::vector<AsyncEvent>& GetEvents() const {
+    return events_;
+  }
+
+  /**
+   * @brief Get the unique ID of the task, used to label the flow links.
+   * @return the task ID.
+   */
+  uint64_t GetTaskId() const {
+    return task_id_;
+  }
+
+private:
+  std::shared_ptr<PerformanceProfiler> profiler_;
+  std::string segment_name_;
+  uint64_t task_id_{};
+  timer_precision_t total_timer_;
+  util::StopWatchTimer suspended_timer_;
+  double on_cpu_ns_{};
+  double running_since_ns_{};  /// thread CPU time at the last Resume()
+  bool running_{ true };
+  std::vector<AsyncEvent> events_;
+  double total_ns_{};
+  bool ended_{};
+};
+
+/**
+ * Awaiter that wraps another awaiter and records the suspension and the
+ * resumption of the awaiting coroutine in an AsyncSegment.
+ */
+template<typename Awaiter>
+class TrackedAwaiter {
+public:
+  TrackedAwaiter(AsyncSegment& segment, Awaiter&& awaiter)
+      : segment_(segment), awaiter_(std::forward<Awaiter>(awaiter)) {
+  }
+
+  bool await_ready() {
+    return awaiter_.await_ready();
+  }
+
+  template<typename Promise>
+  decltype(auto) await_suspend(std::coroutine_handle<Promise> handle) {
+    // Record before handing the coroutine over, it may be resumed on another
+    // thread before await_suspend returns. If it returns false the coroutine
+    // continues right away and await_resume ends the short suspension.
+    suspended_ = true;
+    segment_.Suspend();
+    return awaiter_.await_suspend(handle);
+  }
+
+  decltype(auto) await_resume() {
+    // await_suspend isn't called when the awaiter was ready.
+    if (suspended_) {
+      suspended_ = false;
+      segment_.Resume();
+    }
+    return awaiter_.await_resume();
+  }
+
+private:
+  AsyncSegment& segment_;
+  Awaiter awaiter_;
+  bool suspended_{};
+};
+
+/**
+ * @brief Track the suspension of a co_await expression, e.g.
+ * co_await performance::Track(segment, socket.Read());
+ * @param segment the segment of the awaiting task.
+ * @param awaitable an awaiter or a type with a member operator co_await.
+ * @return the tracked awaiter.
+ */
+template<typename Awaitable>
+auto Track(AsyncSegment& segment, Awaitable&& awaitable) {
+  if constexpr (requires {
+                  std::forward<Awaitable>(awaitable).operator co_await();
+                }) {
+    using awaiter_t =
+        decltype(std::forward<Awaitable>(awaitable).operator co_await());
+    return TrackedAwaiter<awaiter_t>(
+        segment, std::forward<Awaitable>(awaitable).operator co_await());
+  } else {
+    return TrackedAwaiter<Awaitable>(
+        segment, std::forward<Awaitable>(awaitable));
+  }
+}
+}  // namespace performance
@@ -0,0 +1,72 @@
+/*
+ Benchmark execution environment.
+
+ Copyright (c) 2024 Thomas Bruckschlegel. All rights reserved.
+*/
+
+#include "benchmark_environment.hpp"
+#include <sstream>
+
+namespace performance {
+std::string EnvironmentSnapshot::Describe() const {
+  std::ostringstream out;
+  out << "scheme=" << (power_scheme.empty() ? "unknown" : power_scheme)
+      << " boost=" << (boost_enabled ? "on" : "off")
+      << " smt=" << (smt_enabled ? "on" : "off") << " cpus=" << logical_cpus
+      << "/" << physical_cores << " mhz=" << current_mhz << "/" << max_mhz
+      << " pinned=" << pinned_cpu
+      << " priority=" << (priority_raised ? "high" : "normal")
+      << " locked=" << (memory_locked ? "yes" : "no")
+      << (IsSuitable() ? " [ok]" : " [noisy]");
+  return out.str();
+}
+
+namespace environment {
+EnvironmentSnapshot Apply(const EnvironmentOptions& options,
+    uint32_t cpu_offset,
+    const WorkingSetLock* lock) {
+  EnvironmentSnapshot snapshot = Capture();
+  if (options.pin_cpu >= 0) {
+    const auto cpu = static_cast<uint32_t>(options.pin_cpu) + cpu_offset;
+    if (PinCurrentThread(cpu))
+      snapshot.pinned_cpu = static_cast<int>(cpu);
+  }
+  if (options.raise_priority)
+    snapshot.priority_raised = RaiseCurrentThreadPriority();
+  if (options.lock_memory_bytes > 0)
+    PrefaultStack();
+  snapshot.memory_locked = lock != nullptr && lock->IsLocked();
+
+  Evaluate(snapshot, options);
+  return snapshot;
+}
+
+void Evaluate(EnvironmentSnapshot& snapshot,
+    const EnvironmentOptions& requested) {
+  snapshot.warnings.clear();
+  if (requested.pin_cpu >= 0 && snapshot.pinned_cpu < 0)
+    snapshot.warnings.push_back("pinning to CPU " +
+                                std::to_string(requested.pin_cpu) +
+                                " (+ worker index) failed");
+  if (requested.raise_priority && !snapshot.priority_raised)
+    snapshot.warnings.push_back("raising the priority failed");
+  if (requested.lock_memory_bytes > 0 && !snapshot.memory_locked)
+    snapshot.warnings.push_back("locking the working set failed");
+  if (!snapshot.performance_scheme)
+    snapshot.warnings.push_back("power scheme '" +
+                                (snapshot.power_scheme.empty()
+                                        ? std::string("unknown")
+                                        : snapshot.power_scheme) +
+                                "' may scale the CPU frequency");
+  if (snapshot.boost_enabled)
+    snapshot.warnings.push_back("turbo/boost is enabled");
+  if (snapshot.smt_enabled)
+    snapshot.warnings.push_back("SMT is enabled");
+  // Allow 10% below the nominal frequency before calling it throttled.
+  if (snapshot.max_mhz > 0 && snapshot.current_mhz * 10 < snapshot.max_mhz * 9)
+    snapshot.warnings.push_back("CPU runs at " +
+                                std::to_string(snapshot.current_mhz) + " of " +
+                                std::to_string(snapshot.max_mhz) + " MHz");
+}
+}  // namespace environment
+}  // namespace performance
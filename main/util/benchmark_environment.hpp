@@ -0,0 +1,142 @@
+/*
+ Benchmark execution environment.
+
+ Copyright (c) 2024 Thomas Bruckschlegel. All rights reserved.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace performance {
+/// Options to reduce noise on the measuring thread.
+struct EnvironmentOptions {
+  int pin_cpu{ -1 };          /// logical CPU to pin to, -1 disables pinning
+  bool raise_priority{};      /// raise process and thread priority
+  size_t lock_memory_bytes{}; /// working set to lock per run, 0 = off
+};
+
+/// State of the machine and of the measuring thread during a benchmark run.
+struct EnvironmentSnapshot {
+  std::string power_scheme;     /// active power scheme (frequency governor)
+  bool performance_scheme{};    /// power scheme favours performance
+  bool boost_enabled{};         /// turbo/boost mode is enabled
+  bool smt_enabled{};           /// at least one core runs several threads
+  uint32_t logical_cpus{};
+  uint32_t physical_cores{};
+  uint32_t current_mhz{};       /// lowest current frequency over all CPUs
+  uint32_t max_mhz{};           /// nominal maximum frequency
+  int pinned_cpu{ -1 };         /// CPU the measuring thread is pinned to
+  bool priority_raised{};
+  bool memory_locked{};         /// a WorkingSetLock is held for the run
+  std::vector<std::string> warnings;
+
+  /**
+   * @brief Check whether the environment is suitable for stable results.
+   * @return true when there are no warnings.
+   */
+  bool IsSuitable() const {
+    return warnings.empty();
+  }
+
+  /**
+   * @brief Get a one line description of the snapshot.
+   * @return the description.
+   */
+  std::string Describe() const;
+};
+
+/**
+ * @brief Raises the hard minimum working set of the process for the lifetime
+ * of the object, so that the pages touched by a run aren't trimmed. The limit
+ * is process wide, hold one lock per run and not one per thread. The previous
+ * limits are restored on destruction.
+ */
+class WorkingSetLock final {
+public:
+  /**
+   * @brief Raise the minimum working set.
+   * @param bytes the additional working set, 0 doesn't lock.
+   */
+  explicit WorkingSetLock(size_t bytes);
+  WorkingSetLock(const WorkingSetLock&) = delete;
+  WorkingSetLock& operator=(const WorkingSetLock&) = delete;
+  ~WorkingSetLock();
+
+  /**
+   * @brief Check whether the working set was raised.
+   * @return true on success.
+   */
+  bool IsLocked() const {
+    return locked_;
+  }
+
+private:
+  size_t previous_min_{};
+  size_t previous_max_{};
+  uint32_t previous_flags_{};
+  bool locked_{};
+};
+
+namespace environment {
+/**
+ * @brief Pin the calling thread to a logical CPU.
+ * @param cpu the logical CPU index over all processor groups.
+ * @return true on success.
+ */
+bool PinCurrentThread(uint32_t cpu);
+
+/**
+ * @brief Raise the scheduling priority of the process and the calling thread,
+ * where permitted.
+ * @return true on success.
+ */
+bool RaiseCurrentThreadPriority();
+
+/**
+ * @brief Get the working set limits of the process.
+ * @param minimum receives the minimum working set in bytes.
+ * @param maximum receives the maximum working set in bytes.
+ * @return true on success.
+ */
+bool GetWorkingSetLimits(size_t& minimum, size_t& maximum);
+
+/**
+ * @brief Pre-fault the stack of the calling thread, so that the first deep
+ * calls of a run don't take page faults.
+ */
+void PrefaultStack();
+
+/**
+ * @brief Apply the given options to the calling thread. With
+ * options.lock_memory_bytes the stack is pre-faulted, the working set itself
+ * is locked by the caller with a WorkingSetLock.
+ * @param options the options to apply.
+ * @param cpu_offset added to options.pin_cpu, e.g. the worker index.
+ * @param lock the working set lock held by the caller for the run, if any.
+ * @return a snapshot of the environment including the applied state, options
+ * that couldn't be applied are flagged as warnings.
+ */
+EnvironmentSnapshot Apply(const EnvironmentOptions& options,
+    uint32_t cpu_offset = 0,
+    const WorkingSetLock* lock = nullptr);
+
+/**
+ * @brief Capture the machine state (power scheme, boost, SMT, frequency) and
+ * evaluate it. The thread state fields are left at their defaults.
+ * @return the snapshot.
+ */
+EnvironmentSnapshot Capture();
+
+/**
+ * @brief Fill the warnings of a snapshot for states that are unsuitable for
+ * stable results, including requested options that weren't applied.
+ * @param snapshot the snapshot to evaluate.
+ * @param requested the options that were requested.
+ */
+void Evaluate(EnvironmentSnapshot& snapshot,
+    const EnvironmentOptions& requested = {});
+}  // namespace environment
+}  // namespace performance
@@ -0,0 +1,201 @@
+/*
+ Benchmark runner.
+
+ Copyright (c) 2024 Thomas Bruckschlegel. All rights reserved.
+*/
+
+#include "benchmark_runner.hpp"
+#include "util/perf_macros.h"
+#include <algorithm>
+#include <barrier>
+#include <cmath>
+#include <numeric>
+#include <thread>
+
+namespace performance {
+BenchmarkRunner::BenchmarkRunner(std::shared_ptr<PerformanceProfiler> profiler)
+    : profiler_(profiler) {
+}
+
+void BenchmarkRunner::Register(const std::string& name,
+    size_t iterations,
+    scenario_t scenario) {
+  scenarios_.push_back(Scenario{ name, iterations, scenario });
+}
+
+void BenchmarkRunner::SetEnvironmentOptions(
+    const EnvironmentOptions& options) {
+  environment_options_ = options;
+}
+
+std::vector<BenchmarkResult> BenchmarkRunner::Run() {
+  const WorkingSetLock lock(environment_options_.lock_memory_bytes);
+  const auto applied = environment::Apply(environment_options_, 0, &lock);
+  OutputEnvironment(applied);
+
+  std::vector<BenchmarkResult> results;
+  for (auto&& scenario : scenarios_) {
+    BenchmarkResult result{};
+    result.scenario = scenario.name;
+    result.threads = 1;
+    result.iterations = scenario.iterations;
+    {
+      LOG_PERF_DYNAMIC(profiler_, scenario.name);
+      timer_precision_t timer;
+      result.checksum = scenario.function(scenario.iterations);
+      result.wall_ns = timer.ElapsedTime();
+    }
+    result.mean_ns = result.wall_ns;
+    if (result.wall_ns > 0)
+      result.throughput = result.iterations * 1e9 / result.wall_ns;
+    result.efficiency = 1.0;
+    result.environment = Refresh(applied);
+
+    if (profiler_ != nullptr) {
+      profiler_->SendComment(
+          scenario.name + " result " + std::to_string(result.checksum));
+      profiler_->SendComment(scenario.name + " environment " +
+                             result.environment.Describe());
+    }
+    results.push_back(result);
+  }
+  return results;
+}
+
+std::vector<BenchmarkResult> BenchmarkRunner::RunScaling(size_t max_threads) {
+  if (max_threads == 0)
+    max_threads = std::max(1u, std::thread::hardware_concurrency());
+
+  OutputEnvironment(environment::Capture());
+
+  const WorkingSetLock lock(environment_options_.lock_memory_bytes);
+  std::vector<BenchmarkResult> results;
+  for (auto&& scenario : scenarios_) {
+    double single_thread_throughput{};
+    for (auto threads : ThreadCounts(max_threads)) {
+      auto result = RunScenario(scenario, threads, lock);
+      if (threads == 1)
+        single_thread_throughput = result.throughput;
+      if (single_thread_throughput > 0)
+        result.efficiency =
+            result.throughput / (threads * single_thread_throughput);
+
+      OutputResult(result);
+      results.push_back(result);
+    }
+  }
+  return results;
+}
+
+std::vector<size_t> BenchmarkRunner::ThreadCounts(size_t max_threads) {
+  std::vector<size_t> counts;
+  for (size_t threads = 1; threads < max_threads; threads *= 2)
+    counts.push_back(threads);
+  counts.push_back(std::max<size_t>(max_threads, 1));
+  return counts;
+}
+
+BenchmarkResult BenchmarkRunner::RunScenario(const Scenario& scenario,
+    size_t threads,
+    const WorkingSetLock& lock) const {
+  std::vector<double> elapsed(threads);
+  std::vector<size_t> checksums(threads);
+  std::vector<EnvironmentSnapshot> environments(threads);
+  std::barrier start(static_cast<std::ptrdiff_t>(threads + 1));
+
+  std::vector<std::thread> workers;
+  workers.reserve(threads);
+  for (size_t i = 0; i < threads; ++i) {
+    workers.emplace_back([&, i]() {
+      environments[i] =
+          environment::Apply(environment_options_, static_cast<uint32_t>(i),
+              &lock);
+      start.arrive_and_wait();
+      // Timed directly, neither the segment filter nor a shared profiler
+      // lock may affect the measurement.
+      timer_precision_t timer;
+      checksums[i] = scenario.function(scenario.iterations);
+      elapsed[i] = timer.ElapsedTime();
+    });
+  }
+
+  start.arrive_and_wait();
+  timer_precision_t wall_timer;
+  for (auto&& worker : workers)
+    worker.join();
+  const auto wall_ns = wall_timer.ElapsedTime();
+
+  // The workers don't use the profiler, publish their times after the run.
+  if (profiler_ != nullptr) {
+    for (auto&& value : elapsed)
+      profiler_->RecordSharedMetric(
+          scenario.name + " x" + std::to_string(threads), value);
+  }
+
+  BenchmarkResult result{};
+  result.scenario = scenario.name;
+  result.threads = threads;
+  result.iterations = scenario.iterations;
+  result.wall_ns = wall_ns;
+  // A control that failed on any worker, e.g. pinning with more workers than
+  // CPUs, makes the whole run noisy.
+  auto applied = environments.front();
+  for (auto&& environment : environments) {
+    if (environment.pinned_cpu < 0)
+      applied.pinned_cpu = -1;
+    applied.priority_raised =
+        applied.priority_raised && environment.priority_raised;
+  }
+  result.environment = Refresh(applied);
+  result.checksum = std::accumulate(checksums.begin(), checksums.end(),
+      size_t{});
+  result.mean_ns =
+      std::accumulate(elapsed.begin(), elapsed.end(), 0.0) / threads;
+  double variance{};
+  for (auto&& value : elapsed)
+    variance += (value - result.mean_ns) * (value - result.mean_ns);
+  result.stddev_ns = std::sqrt(variance / threads);
+  if (result.wall_ns > 0)
+    result.throughput =
+        threads * result.iterations * 1e9 / result.wall_ns;
+  return result;
+}
+
+void BenchmarkRunner::OutputResult(const BenchmarkResult& result) const {
+  if (profiler_ == nullptr)
+    return;
+
+  const auto label = result.scenario + " x" + std::to_string(result.threads);
+  profiler_->SendValue(label + " wall", result.wall_ns, ProfilerUnit::kNS);
+  profiler_->SendValue(label + " mean", result.mean_ns, ProfilerUnit::kNS);
+  profiler_->SendValue(label + " stddev", result.stddev_ns, ProfilerUnit::kNS);
+  profiler_->SendValue(label + " throughput", result.throughput,
+      ProfilerUnit::kOpsPerSecond);
+  profiler_->SendValue(label + " efficiency", result.efficiency * 100,
+      ProfilerUnit::kPercent);
+  profiler_->SendComment(label + " environment " +
+                         result.environment.Describe());
+}
+
+void BenchmarkRunner::OutputEnvironment(
+    const EnvironmentSnapshot& snapshot) const {
+  if (profiler_ == nullptr)
+    return;
+
+  profiler_->SendComment("environment " + snapshot.Describe());
+  for (auto&& warning : snapshot.warnings)
+    profiler_->SendComment("WARNING: " + warning);
+}
+
+EnvironmentSnapshot BenchmarkRunner::Refresh(
+    const EnvironmentSnapshot& applied) const {
+  // The machine state may change during a run (e.g. thermal throttling), the
+  // thread state stays as applied.
+  auto snapshot = environment::Capture();
+  snapshot.pinned_cpu = applied.pinned_cpu;
+  snapshot.priority_raised = applied.priority_raised;
+  snapshot.memory_locked = applied.memory_locked;
+  environment::Evaluate(snapshot, environment_options_);
+  return snapshot;
+}
+}  // namespace performance
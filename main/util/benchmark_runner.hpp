@@ -0,0 +1,100 @@
+/*
+ Benchmark runner.
+
+ Copyright (c) 2024 Thomas Bruckschlegel. All rights reserved.
+*/
+
+#pragma once
+
+#include "util/performance_profiler.hpp"
+#include "util/benchmark_environment.hpp"
+#include <string>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace performance {
+/// A benchmark scenario runs the given number of iterations and returns a
+/// value derived from the work, so that it can't be optimized away.
+using scenario_t = std::function<size_t(size_t iterations)>;
+
+/// Result of one scenario run at a given thread count.
+struct BenchmarkResult {
+  std::string scenario;
+  size_t threads{};
+  size_t iterations{};  /// iterations per thread
+  size_t checksum{};    /// sum of the values returned by all threads
+  double wall_ns{};     /// barrier release until the last thread finished
+  double mean_ns{};     /// mean per-thread time
+  double stddev_ns{};   /// standard deviation of the per-thread times
+  double throughput{};  /// iterations per second over all threads
+  double efficiency{};  /// throughput / (threads * single-thread throughput)
+  EnvironmentSnapshot environment;  /// environment of the (first) thread
+};
+
+class BenchmarkRunner final {
+public:
+  BenchmarkRunner() = delete;
+  /**
+   * @brief Create a benchmark runner that reports its results to the given
+   * profiler.
+   * @param profiler the performance profiler used for reporting.
+   */
+  explicit BenchmarkRunner(std::shared_ptr<PerformanceProfiler> profiler);
+
+  /**
+   * @brief Register a benchmark scenario.
+   * @param name the scenario name, used as profiler segment name.
+   * @param iterations the number of iterations each thread runs.
+   * @param scenario the scenario function.
+   */
+  void Register(const std::string& name, size_t iterations,
+      scenario_t scenario);
+
+  /**
+   * @brief Set the noise control options applied to the measuring threads.
+   * @param options the environment options.
+   */
+  void SetEnvironmentOptions(const EnvironmentOptions& options);
+
+  /**
+   * @brief Run every registered scenario once on the calling thread.
+   * @return the result of each scenario.
+   */
+  std::vector<BenchmarkResult> Run();
+
+  /**
+   * @brief Run every registered scenario at 1, 2, 4 ... max_threads threads
+   * and report throughput, per-thread variance and scaling efficiency.
+   * @param max_threads the highest thread count, 0 means all hardware threads.
+   * @return the result of each scenario at each thread count.
+   */
+  std::vector<BenchmarkResult> RunScaling(size_t max_threads);
+
+  /**
+   * @brief Get the thread counts used by RunScaling, i.e. the powers of two
+   * below max_threads followed by max_threads itself.
+   * @param max_threads the highest thread count.
+   * @return the thread counts in ascending order.
+   */
+  static std::vector<size_t> ThreadCounts(size_t max_threads);
+
+private:
+  struct Scenario {
+    std::string name;
+    size_t iterations{};
+    scenario_t function;
+  };
+
+  BenchmarkResult RunScenario(const Scenario& scenario,
+      size_t threads,
+      const WorkingSetLock& lock) const;
+  void OutputResult(const BenchmarkResult& result) const;
+  void OutputEnvironment(const EnvironmentSnapshot& snapshot) const;
+  EnvironmentSnapshot Refresh(const EnvironmentSnapshot& applied) const;
+
+  std::shared_ptr<PerformanceProfiler> profiler_;
+  std::vector<Scenario> scenarios_;
+  EnvironmentOptions environment_options_;
+};
+}  // namespace performance
@@ -7,7 +7,16 @@
 #pragma once
 #include "util/performance_profiler.hpp"
 
-#define LOG_PERF(p, x) performance::PerformanceObject pobj_##__LINE__(p, x)
+// Segment with a fixed name, x must be a string literal. The name is checked
+// against the SegmentFilter once per call site.
+#define LOG_PERF(p, x)                                                 \
+  static const performance::SegmentHandle pseg_##__LINE__("" x);       \
+  performance::PerformanceObject pobj_##__LINE__(p, pseg_##__LINE__)
+
+// Segment with a name computed at runtime, checked against the SegmentFilter
+// on every call.
+#define LOG_PERF_DYNAMIC(p, x) \
+  performance::PerformanceObject pobj_##__LINE__(p, x)
 
 #define LOG_MEM(p, pid, x)   \
   {                          \
@@ -6,18 +6,29 @@
 
 #include "performance_profiler.hpp"
 #include <algorithm>
+#include <vector>
 #include <Windows.h>
 
 namespace performance {
+namespace {
+// Set while the calling thread runs the calibration loop, Start() and End()
+// then skip the output and add the raw segment time and their own call time
+// to the calibration sums.
+thread_local bool calibrating = false;
+thread_local double calibration_raw_sum = 0;
+thread_local double calibration_call_sum = 0;
+}  // namespace
+
 PerformanceProfiler::PerformanceProfiler(
     profiler_output_handler_t output_handler)
     : output_handler_(output_handler) {
+  Calibrate();
 }
 
 void PerformanceProfiler::Shutdown() {
   std::lock_guard lock(mutex_);
-  for (auto&& [segment_name, timer] : running_)
-    output_handler_(segment_name, timer.ElapsedTime(),
+  for (auto&& [segment_name, segment] : running_)
+    output_handler_(segment_name, segment.timer.ElapsedTime(),
         ProfilerUnitString(ProfilerUnit::kNS));
 
   for (auto&& [pid, pmd] : processes_)
@@ -25,24 +36,144 @@ void PerformanceProfiler::Shutdown() {
 }
 
 void PerformanceProfiler::Start(const std::string& segment_name) {
+  timer_precision_t call_timer;
   std::lock_guard lock(mutex_);
-  SendComment("Starting " + segment_name);
-  running_.insert(std::make_pair(segment_name, timer_precision_t{}));
+  if (!calibrating)
+    SendComment("Starting " + segment_name);
+
+  const auto&& [it, inserted] =
+      running_.insert(std::make_pair(segment_name, detail::RunningSegment{}));
+  if (!inserted)
+    return;
+
+  auto& segment = it->second;
+  segment.owner = std::this_thread::get_id();
+  segment.start_cost_ns = call_timer.ElapsedTime();
+  segment.timer.Reset();
 }
 
 void PerformanceProfiler::End(const std::string& segment_name) {
+  timer_precision_t call_timer;
   std::unique_lock lock(mutex_);
   const auto&& it = running_.find(segment_name);
   if (it == running_.end())
     return;
 
-  const auto& timer = it->second;
-  output_handler_(
-      segment_name, timer.ElapsedTime(), ProfilerUnitString(ProfilerUnit::kNS));
+  const auto& segment = it->second;
+  const auto raw = segment.timer.ElapsedTime();
+  const auto owner = segment.owner;
+  const auto start_cost = segment.start_cost_ns;
+  const auto corrected =
+      (std::max)(0.0, raw - overhead_ns_ - segment.child_cost_ns);
   running_.erase(it);
 
+  if (calibrating) {
+    calibration_raw_sum += raw;
+    calibration_call_sum += start_cost + call_timer.ElapsedTime();
+    return;
+  }
+
+  if (shared_metrics_ != nullptr)
+    shared_metrics_->Record(segment_name, raw);
+
+  output_handler_(segment_name, raw, ProfilerUnitString(ProfilerUnit::kNS));
+  output_handler_(segment_name + " (corrected)", corrected,
+      ProfilerUnitString(ProfilerUnit::kNS));
+
+  const bool calibration_due =
+      calibration_interval_.count() > 0 &&
+      calibration_timer_.ElapsedTime() >=
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              calibration_interval_)
+              .count();
+  if (calibration_due)
+    calibration_timer_.Reset();
+
   lock.unlock();
   CollectMemoryUsage();
+  if (calibration_due)
+    Calibrate();
+
+  // Everything this segment spent inside Start() and End(), plus the
+  // calibrated cost of the scope around them, is overhead for the enclosing
+  // segments of the same thread.
+  lock.lock();
+  const auto cost =
+      start_cost + call_timer.ElapsedTime() + nested_overhead_ns_;
+  for (auto&& [name, running] : running_) {
+    if (running.owner == owner)
+      running.child_cost_ns += cost;
+  }
+}
+
+double PerformanceProfiler::Calibrate() {
+  constexpr size_t kBatches = 21;
+  constexpr size_t kBatchSize = 100;
+  static const SegmentHandle calibration_segment("# calibration");
+  // Same path as LOG_PERF, the profiler isn't owned by the pointer.
+  const std::shared_ptr<PerformanceProfiler> profiler(
+      this, [](PerformanceProfiler*) {});
+
+  // A single scope is close to the clock resolution (100 ns with QPC), so
+  // every batch is timed with one clock read and the segment times are
+  // averaged, which evens out the rounding.
+  std::vector<double> in_scope(kBatches);
+  std::vector<double> nested(kBatches);
+  calibrating = true;
+  for (size_t batch = 0; batch < kBatches; ++batch) {
+    calibration_raw_sum = 0;
+    calibration_call_sum = 0;
+    timer_precision_t batch_timer;
+    for (size_t i = 0; i < kBatchSize; ++i) {
+      PerformanceObject scope(profiler, calibration_segment);
+    }
+    const auto total = batch_timer.ElapsedTime();
+    in_scope[batch] = calibration_raw_sum / kBatchSize;
+    nested[batch] = (total - calibration_call_sum) / kBatchSize;
+  }
+  calibrating = false;
+
+  // The median ignores batches that were preempted or waited for the lock.
+  const auto median = [](std::vector<double>& values) {
+    std::nth_element(
+        values.begin(), values.begin() + values.size() / 2, values.end());
+    return (std::max)(0.0, values[values.size() / 2]);
+  };
+  const auto overhead = median(in_scope);
+  overhead_ns_ = overhead;
+  nested_overhead_ns_ = median(nested);
+
+  {
+    std::lock_guard lock(mutex_);
+    calibration_timer_.Reset();
+  }
+  SendComment("Profiler overhead " + std::to_string(overhead) + " ns");
+  return overhead;
+}
+
+void PerformanceProfiler::SetCalibrationInterval(
+    std::chrono::milliseconds interval) {
+  std::lock_guard lock(mutex_);
+  calibration_interval_ = interval;
+}
+
+bool PerformanceProfiler::EnableSharedMetrics(const std::string& name) {
+  std::lock_guard lock(mutex_);
+  // Detach first, a region can only have one writer.
+  shared_metrics_.reset();
+  auto writer = std::make_unique<shared_metrics::Writer>(name);
+  if (!writer->IsOpen())
+    return false;
+
+  shared_metrics_ = std::move(writer);
+  return true;
+}
+
+void PerformanceProfiler::RecordSharedMetric(const std::string& segment_name,
+    double ns) {
+  std::lock_guard lock(mutex_);
+  if (shared_metrics_ != nullptr)
+    shared_metrics_->Record(segment_name, ns);
 }
 
 void PerformanceProfiler::AddProcess(uint32_t pid,
@@ -76,11 +207,20 @@ void PerformanceProfiler::SendComment(const std::string& comment) const {
       "# " + comment, 0, ProfilerUnitString(ProfilerUnit::kComment));
 }
 
+void PerformanceProfiler::SendValue(const std::string& name,
+    double value,
+    ProfilerUnit unit) const {
+  output_handler_(name, value, ProfilerUnitString(unit));
+}
+
 void PerformanceProfiler::OutputMemoryUsage(uint32_t pid,
     const detail::ProcessMemoryData& pmd) {
   constexpr auto get_label = [](auto&& pid, auto&& pname, auto&& suffix) {
     return pname + ":" + std::to_string(pid) + " " + suffix;
   };
+  if (shared_metrics_ != nullptr)
+    shared_metrics_->RecordMemory(pid, pmd.private_size, pmd.peak_working_size);
+
   output_handler_(get_label(pid, pmd.process_name, "(current)"),
       static_cast<double>(pmd.private_size),
       ProfilerUnitString(ProfilerUnit::kMB));
@@ -93,12 +233,10 @@ PerformanceObject::PerformanceObject(
     std::shared_ptr<PerformanceProfiler> profiler,
     const std::string& segment_name)
     : profiler_(profiler), segment_name_(segment_name) {
+  if (profiler_ != nullptr &&
+      !SegmentFilter::Instance().IsEnabled(segment_name_))
+    profiler_.reset();
   if (profiler_ != nullptr)
     profiler_->Start(segment_name_);
 }
-
-PerformanceObject::~PerformanceObject() {
-  if (profiler_ != nullptr)
-    profiler_->End(segment_name_);
-}
 }  // namespace performance
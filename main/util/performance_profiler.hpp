@@ -7,10 +7,16 @@
 #pragma once
 
 #include "util/timer.hpp"
+#include "util/shared_metrics.hpp"
+#include "util/segment_filter.hpp"
 #include <string>
 #include <functional>
 #include <unordered_map>
 #include <mutex>
+#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 namespace performance {
 using profiler_output_handler_t = std::function<
@@ -23,13 +29,22 @@ struct ProcessMemoryData {
   size_t private_size{};
   size_t peak_working_size{};
 };
+
+struct RunningSegment {
+  timer_precision_t timer;
+  std::thread::id owner;
+  double start_cost_ns{};  /// time spent in Start()
+  double child_cost_ns{};  /// Start()/End() time of nested segments
+};
 }  // namespace detail
 
 /// Units used by the profiler.
 enum class ProfilerUnit {
-  kNS,      /// nanoseconds
-  kMB,      /// megabytes
-  kComment  /// comment
+  kNS,           /// nanoseconds
+  kMB,           /// megabytes
+  kComment,      /// comment
+  kOpsPerSecond, /// operations per second
+  kPercent       /// percent
 };
 
 /**
@@ -42,7 +57,9 @@ struct ProfilerUnitString final {
   operator std::string() const {
     static std::unordered_map<ProfilerUnit, std::string> strings{
       { ProfilerUnit::kNS, "ns" }, { ProfilerUnit::kMB, "MB" },
-      { ProfilerUnit::kComment, "Comment" }
+      { ProfilerUnit::kComment, "Comment" },
+      { ProfilerUnit::kOpsPerSecond, "ops/s" },
+      { ProfilerUnit::kPercent, "%" }
     };
     if (const auto&& it = std::find_if(strings.begin(), strings.end(),
             [&](auto&& i) { return value == i.first; });
@@ -79,11 +96,57 @@ public:
 
   /**
    * @brief Stop tracking of a segment and outputs the time taken in the section
-   * and also memory usage for all tracked processes.
+   * and also memory usage for all tracked processes. The time is reported
+   * twice, raw and as "<segment> (corrected)" with the profiler overhead and
+   * the whole cost of nested segments (PerformanceObject, Start() and End())
+   * subtracted.
    * @param segment_name the segment name.
    */
   void End(const std::string& segment_name);
 
+  /**
+   * @brief Measure the overhead the profiler adds to a segment, by timing
+   * batches of empty PerformanceObject scopes with one clock read per batch,
+   * so that the clock resolution doesn't bias the result. Called on
+   * construction and, see SetCalibrationInterval, periodically from End().
+   * @return the overhead inside a segment in nanoseconds.
+   */
+  double Calibrate();
+
+  /**
+   * @brief Get the overhead per segment measured by the last calibration.
+   * @return the overhead in nanoseconds.
+   */
+  double GetOverhead() const {
+    return overhead_ns_;
+  }
+
+  /**
+   * @brief Set how often the overhead is re-calibrated.
+   * @param interval the calibration interval, zero disables re-calibration.
+   */
+  void SetCalibrationInterval(std::chrono::milliseconds interval);
+
+  /**
+   * @brief Publish per-segment counters, histograms and the memory usage of
+   * this process to a named shared memory region, which external tools (see
+   * tools/perf_top.cpp) can read while the process is running.
+   * Replaces a previously enabled region.
+   * @param name the shared memory region name.
+   * @return true if the region was created, false e.g. if another running
+   * producer publishes to it.
+   */
+  bool EnableSharedMetrics(const std::string& name);
+
+  /**
+   * @brief Publish a segment time that was measured without Start()/End(),
+   * e.g. by benchmark worker threads, to the shared metrics region. Does
+   * nothing unless EnableSharedMetrics was called.
+   * @param segment_name the segment name.
+   * @param ns the segment time in nanoseconds.
+   */
+  void RecordSharedMetric(const std::string& segment_name, double ns);
+
   /**
    * @brief Start tracking memory usage of a given PID and process name.
    * @param pid the process ID.
@@ -110,13 +173,30 @@ public:
    */
   void SendComment(const std::string& comment) const;
 
+  /**
+   * @brief Send a named value to the output handler.
+   * @param name the value name.
+   * @param value the value.
+   * @param unit the unit of the value.
+   */
+  void SendValue(const std::string& name,
+      double value,
+      ProfilerUnit unit) const;
+
 private:
   void OutputMemoryUsage(uint32_t pid, const detail::ProcessMemoryData& pmd);
 
-  std::unordered_map<std::string, timer_precision_t> running_;
+  std::unordered_map<std::string, detail::RunningSegment> running_;
   std::unordered_map<uint32_t, detail::ProcessMemoryData> processes_;
   profiler_output_handler_t output_handler_;
   std::mutex mutex_;
+  std::atomic<double> overhead_ns_{};
+  // Cost of an empty nested scope that the Start()/End() call timers of the
+  // child don't see, e.g. the PerformanceObject and the timer reads.
+  std::atomic<double> nested_overhead_ns_{};
+  timer_precision_t calibration_timer_;
+  std::chrono::milliseconds calibration_interval_{ 10000 };
+  std::unique_ptr<shared_metrics::Writer> shared_metrics_;
 };
 
 class PerformanceObject {
@@ -124,13 +204,36 @@ public:
   PerformanceObject() = delete;
   /**
    * @brief Create a performance object that can be used to track code sections.
+   * The segment name is checked against the SegmentFilter on every call, see
+   * the SegmentHandle overload for segments with a fixed name.
    * @param profiler the performance profiler associated with the performance
    * object instance.
    * @param segment_name the segment name.
    */
   explicit PerformanceObject(std::shared_ptr<PerformanceProfiler> profiler,
       const std::string& segment_name);
-  ~PerformanceObject();
+
+  /**
+   * @brief Create a performance object for a segment with a fixed name. A
+   * segment disabled by the SegmentFilter costs a single branch.
+   * @param profiler the performance profiler associated with the performance
+   * object instance.
+   * @param segment the segment handle.
+   */
+  explicit PerformanceObject(
+      const std::shared_ptr<PerformanceProfiler>& profiler,
+      const SegmentHandle& segment) {
+    if (segment.IsEnabled() && profiler != nullptr) {
+      profiler_ = profiler;
+      segment_ = &segment;
+      profiler_->Start(segment.GetName());
+    }
+  }
+
+  ~PerformanceObject() {
+    if (profiler_ != nullptr)
+      profiler_->End(segment_ != nullptr ? segment_->GetName() : segment_name_);
+  }
 
   /**
    * @brief Get the performance profiler instance associated with this
@@ -144,5 +247,6 @@ public:
 private:
   std::shared_ptr<PerformanceProfiler> profiler_;
   std::string segment_name_;
+  const SegmentHandle* segment_{};
 };
 }  // namespace performance
@@ -0,0 +1,169 @@
+/*
+ Performance profiler - runtime segment filter.
+
+ Copyright (c) 2024 Thomas Bruckschlegel. All rights reserved.
+*/
+
+#include "segment_filter.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace performance {
+namespace {
+std::string Trim(const std::string& s) {
+  const auto first = s.find_first_not_of(" \t\r");
+  if (first == std::string::npos)
+    return {};
+  const auto last = s.find_last_not_of(" \t\r");
+  return s.substr(first, last - first + 1);
+}
+}  // namespace
+
+SegmentHandle::SegmentHandle(const std::string& segment_name)
+    : segment_name_(segment_name) {
+  SegmentFilter::Instance().Register(this);
+}
+
+SegmentHandle::~SegmentHandle() {
+  SegmentFilter::Instance().Unregister(this);
+}
+
+SegmentFilter::SegmentFilter() {
+  LoadFromEnvironment();
+}
+
+SegmentFilter& SegmentFilter::Instance() {
+  static SegmentFilter filter;
+  return filter;
+}
+
+void SegmentFilter::SetPatterns(const std::string& patterns) {
+  std::vector<Pattern> parsed;
+  bool has_includes{};
+  std::string line;
+  std::istringstream lines(patterns);
+  while (std::getline(lines, line)) {
+    // A '#' comments out the rest of the line.
+    line = line.substr(0, line.find('#'));
+    std::replace(line.begin(), line.end(), ';', ',');
+
+    std::string glob;
+    std::istringstream globs(line);
+    while (std::getline(globs, glob, ',')) {
+      glob = Trim(glob);
+      if (glob.empty())
+        continue;
+
+      Pattern pattern{};
+      pattern.exclude = glob.front() == '-';
+      pattern.glob = pattern.exclude ? glob.substr(1) : glob;
+      has_includes |= !pattern.exclude;
+      parsed.push_back(pattern);
+    }
+  }
+
+  std::lock_guard lock(mutex_);
+  patterns_ = std::move(parsed);
+  has_includes_ = has_includes;
+  for (auto handle : handles_)
+    handle->enabled_.store(IsEnabledLocked(handle->segment_name_),
+        std::memory_order_relaxed);
+}
+
+bool SegmentFilter::LoadFromFile(const std::string& path) {
+  std::ifstream file(path);
+  if (!file)
+    return false;
+
+  std::ostringstream patterns;
+  patterns << file.rdbuf();
+  {
+    std::lock_guard lock(mutex_);
+    file_ = path;
+  }
+  SetPatterns(patterns.str());
+  return true;
+}
+
+void SegmentFilter::LoadFromEnvironment() {
+  const auto path = detail::GetEnvironmentString(kFilterFileVariable);
+  if (!path.empty() && LoadFromFile(path))
+    return;
+
+  {
+    std::lock_guard lock(mutex_);
+    file_.clear();
+  }
+  SetPatterns(detail::GetEnvironmentString(kFilterVariable));
+}
+
+void SegmentFilter::Reload() {
+  std::string path;
+  {
+    std::lock_guard lock(mutex_);
+    path = file_;
+  }
+  if (path.empty() || !LoadFromFile(path))
+    LoadFromEnvironment();
+}
+
+bool SegmentFilter::IsEnabled(const std::string& segment_name) const {
+  std::lock_guard lock(mutex_);
+  return IsEnabledLocked(segment_name);
+}
+
+bool SegmentFilter::IsEnabledLocked(const std::string& segment_name) const {
+  // Names starting with '#' belong to the profiler itself, e.g. its
+  // calibration, and aren't filtered.
+  if (!segment_name.empty() && segment_name.front() == '#')
+    return true;
+
+  bool included = !has_includes_;
+  for (auto&& pattern : patterns_) {
+    if (pattern.exclude && Match(pattern.glob, segment_name))
+      return false;
+    if (!pattern.exclude && !included && Match(pattern.glob, segment_name))
+      included = true;
+  }
+  return included;
+}
+
+bool SegmentFilter::Match(std::string_view pattern, std::string_view name) {
+  // Iterative glob match, backtracks to the last '*' on mismatch.
+  size_t p = 0;
+  size_t n = 0;
+  size_t star = std::string_view::npos;
+  size_t star_n = 0;
+  while (n < name.size()) {
+    if (p < pattern.size() && pattern[p] == '*') {
+      star = p++;
+      star_n = n;
+    } else if (p < pattern.size() &&
+               (pattern[p] == '?' || pattern[p] == name[n])) {
+      ++p;
+      ++n;
+    } else if (star != std::string_view::npos) {
+      p = star + 1;
+      n = ++star_n;
+    } else {
+      return false;
+    }
+  }
+  while (p < pattern.size() && pattern[p] == '*')
+    ++p;
+  return p == pattern.size();
+}
+
+void SegmentFilter::Register(SegmentHandle* handle) {
+  std::lock_guard lock(mutex_);
+  handle->enabled_.store(
+      IsEnabledLocked(handle->segment_name_), std::memory_order_relaxed);
+  handles_.insert(handle);
+}
+
+void SegmentFilter::Unregister(SegmentHandle* handle) {
+  std::lock_guard lock(mutex_);
+  handles_.erase(handle);
+}
+}  // namespace performance
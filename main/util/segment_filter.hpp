@@ -0,0 +1,141 @@
+/*
+ Performance profiler - runtime segment filter.
+
+ Copyright (c) 2024 Thomas Bruckschlegel. All rights reserved.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace performance {
+/**
+ * Handle of a segment with a fixed name, one per LOG_PERF call site. The
+ * enabled bit is resolved against the SegmentFilter when the handle is
+ * created and on every filter change, so checking it costs a single load.
+ */
+class SegmentHandle final {
+public:
+  SegmentHandle() = delete;
+  SegmentHandle(const SegmentHandle&) = delete;
+  SegmentHandle& operator=(const SegmentHandle&) = delete;
+
+  /**
+   * @brief Create a segment handle and register it with the filter.
+   * @param segment_name the segment name.
+   */
+  explicit SegmentHandle(const std::string& segment_name);
+  ~SegmentHandle();
+
+  bool IsEnabled() const {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  const std::string& GetName() const {
+    return segment_name_;
+  }
+
+private:
+  friend class SegmentFilter;
+
+  std::string segment_name_;
+  std::atomic<bool> enabled_{ true };
+};
+
+/**
+ * Enables or disables segments by name. Patterns are globs ('*' and '?'),
+ * separated by ',', ';' or new lines, a leading '-' excludes. Without include
+ * patterns every segment that isn't excluded is enabled, e.g.
+ * "net.*,db.*,-*.poll" or "-*" to disable everything. Names starting with
+ * '#' are internal to the profiler and always enabled.
+ *
+ * The patterns are read from the PERF_FILTER_FILE file (one pattern per line,
+ * '#' starts a comment) or, if that isn't set, the PERF_FILTER environment
+ * variable.
+ */
+class SegmentFilter final {
+public:
+  static constexpr const char* kFilterVariable = "PERF_FILTER";
+  static constexpr const char* kFilterFileVariable = "PERF_FILTER_FILE";
+
+  SegmentFilter(const SegmentFilter&) = delete;
+  SegmentFilter& operator=(const SegmentFilter&) = delete;
+
+  /**
+   * @brief Get the process wide filter, configured from the environment on
+   * first use.
+   * @return the segment filter.
+   */
+  static SegmentFilter& Instance();
+
+  /**
+   * @brief Replace the patterns and re-resolve every segment handle.
+   * @param patterns the patterns, see class description.
+   */
+  void SetPatterns(const std::string& patterns);
+
+  /**
+   * @brief Load the patterns from a file and remember it for Reload().
+   * @param path the file path.
+   * @return false if the file can't be read, the patterns are kept then.
+   */
+  bool LoadFromFile(const std::string& path);
+
+  /**
+   * @brief Load the patterns from the environment, see class description.
+   */
+  void LoadFromEnvironment();
+
+  /**
+   * @brief Load the patterns again from the file given to LoadFromFile() or
+   * the environment.
+   */
+  void Reload();
+
+  /**
+   * @brief Check a segment name against the patterns. Used for segments
+   * without a handle, segments with a handle use SegmentHandle::IsEnabled().
+   * @param segment_name the segment name.
+   * @return true if the segment is enabled.
+   */
+  bool IsEnabled(const std::string& segment_name) const;
+
+  /**
+   * @brief Match a name against a glob pattern.
+   * @param pattern the pattern, '*' matches any sequence and '?' any
+   * character.
+   * @param name the name.
+   * @return true on match.
+   */
+  static bool Match(std::string_view pattern, std::string_view name);
+
+private:
+  friend class SegmentHandle;
+
+  struct Pattern {
+    std::string glob;
+    bool exclude{};
+  };
+
+  SegmentFilter();
+  void Register(SegmentHandle* handle);
+  void Unregister(SegmentHandle* handle);
+  bool IsEnabledLocked(const std::string& segment_name) const;
+
+  mutable std::mutex mutex_;
+  std::vector<Pattern> patterns_;
+  bool has_includes_{};
+  std::string file_;
+  std::unordered_set<SegmentHandle*> handles_;
+};
+
+namespace detail {
+/// Platform specific, see util/win/segment_filter_win.cpp.
+std::string GetEnvironmentString(const std::string& name);
+}  // namespace detail
+}  // namespace performance
@@ -0,0 +1,245 @@
+/*
+ Performance profiler - live metrics in shared memory.
+
+ Copyright (c) 2024 Thomas Bruckschlegel. All rights reserved.
+*/
+
+#include "shared_metrics.hpp"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+namespace performance {
+namespace shared_metrics {
+namespace {
+constexpr auto kRelaxed = std::memory_order_relaxed;
+// A sequence number that stays odd this long belongs to a producer that
+// died while writing, readers give up instead of spinning forever.
+constexpr int kMaxReadRetries = 100000;
+
+void Add(counter_t& counter, uint64_t value) {
+  // Single writer, a plain load/store pair is enough.
+  counter.store(counter.load(kRelaxed) + value, kRelaxed);
+}
+
+bool ReadSlot(const SegmentSlot& slot, SegmentSnapshot& segment) {
+  for (int retry = 0;; ++retry) {
+    if (retry == kMaxReadRetries)
+      return false;
+
+    const auto begin = slot.sequence.load(std::memory_order_acquire);
+    if (begin & 1) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    segment.count = slot.count.load(kRelaxed);
+    segment.total_ns = slot.total_ns.load(kRelaxed);
+    segment.min_ns = slot.min_ns.load(kRelaxed);
+    segment.max_ns = slot.max_ns.load(kRelaxed);
+    segment.last_ns = slot.last_ns.load(kRelaxed);
+    for (uint32_t i = 0; i < kHistogramBuckets; ++i)
+      segment.histogram[i] = slot.histogram[i].load(kRelaxed);
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(kRelaxed) == begin)
+      break;
+  }
+
+  if (segment.count == 0)
+    segment.min_ns = 0;
+  return true;
+}
+}  // namespace
+
+double SegmentSnapshot::Percentile(double percentile) const {
+  if (count == 0)
+    return 0;
+
+  const double rank = percentile / 100.0 * static_cast<double>(count);
+  uint64_t cumulative = 0;
+  for (uint32_t i = 0; i < kHistogramBuckets; ++i) {
+    if (histogram[i] == 0)
+      continue;
+
+    if (static_cast<double>(cumulative + histogram[i]) >= rank) {
+      if (i == 0)
+        return 0;
+
+      // Interpolate linearly inside the bucket.
+      const double lower = std::ldexp(1.0, static_cast<int>(i) - 1);
+      const double upper = std::ldexp(1.0, static_cast<int>(i));
+      const double fraction = (rank - static_cast<double>(cumulative)) /
+                              static_cast<double>(histogram[i]);
+      return std::clamp(lower + fraction * (upper - lower),
+          static_cast<double>(min_ns), static_cast<double>(max_ns));
+    }
+    cumulative += histogram[i];
+  }
+  return static_cast<double>(max_ns);
+}
+
+Writer::Writer(const std::string& name) {
+  if (!detail::CreateSharedMemory(name, sizeof(Region), memory_))
+    return;
+
+  const auto region = static_cast<Region*>(memory_.view);
+  if (memory_.existed && region->magic == kMagic) {
+    const auto owner = region->pid.load(kRelaxed);
+    if (owner != 0 && detail::IsProcessRunning(owner)) {
+      detail::CloseSharedMemory(memory_);
+      return;
+    }
+  }
+
+  // The slots of a previous producer are reset when they are claimed again.
+  region_ = region;
+  region_->version = kVersion;
+  region_->region_size = sizeof(Region);
+  region_->pid.store(detail::CurrentProcessId(), kRelaxed);
+  region_->segment_count.store(0, kRelaxed);
+  // Like the slot sequence numbers, a dead producer may have left it odd.
+  region_->memory_sequence.store(
+      (region_->memory_sequence.load(kRelaxed) | 1) + 1, kRelaxed);
+  RecordMemory(region_->pid.load(kRelaxed), 0, 0);
+  // Readers check the magic first, publish it last.
+  std::atomic_thread_fence(std::memory_order_release);
+  region_->magic = kMagic;
+}
+
+Writer::~Writer() {
+  if (region_ != nullptr)
+    region_->pid.store(0, kRelaxed);
+  detail::CloseSharedMemory(memory_);
+}
+
+void Writer::Record(const std::string& segment_name, double ns) {
+  if (region_ == nullptr)
+    return;
+
+  uint32_t index{};
+  if (const auto&& it = slots_.find(segment_name); it != slots_.end()) {
+    index = it->second;
+  } else {
+    index = region_->segment_count.load(kRelaxed);
+    if (index >= kMaxSegments)
+      return;
+
+    // Readers of a taken over region may still look at the slot, reset it
+    // under an odd sequence number. A producer that died while writing the
+    // slot may have left the sequence number odd.
+    auto& slot = region_->slots[index];
+    const auto sequence = slot.sequence.load(kRelaxed) | 1;
+    slot.sequence.store(sequence, kRelaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const auto length = (std::min)(segment_name.size(),
+        static_cast<size_t>(kMaxNameLength - 1));
+    std::memcpy(slot.name, segment_name.data(), length);
+    std::memset(slot.name + length, 0, kMaxNameLength - length);
+    slot.count.store(0, kRelaxed);
+    slot.total_ns.store(0, kRelaxed);
+    slot.min_ns.store((std::numeric_limits<uint64_t>::max)(), kRelaxed);
+    slot.max_ns.store(0, kRelaxed);
+    slot.last_ns.store(0, kRelaxed);
+    for (auto&& bucket : slot.histogram)
+      bucket.store(0, kRelaxed);
+
+    slot.sequence.store(sequence + 1, std::memory_order_release);
+    region_->segment_count.store(index + 1, std::memory_order_release);
+    slots_.emplace(segment_name, index);
+  }
+
+  const auto value = static_cast<uint64_t>((std::max)(ns, 0.0));
+  const auto bucket = (std::min)(static_cast<uint32_t>(std::bit_width(value)),
+      kHistogramBuckets - 1);
+
+  auto& slot = region_->slots[index];
+  const auto sequence = slot.sequence.load(kRelaxed);
+  slot.sequence.store(sequence + 1, kRelaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  Add(slot.count, 1);
+  Add(slot.total_ns, value);
+  Add(slot.histogram[bucket], 1);
+  slot.last_ns.store(value, kRelaxed);
+  if (value < slot.min_ns.load(kRelaxed))
+    slot.min_ns.store(value, kRelaxed);
+  if (value > slot.max_ns.load(kRelaxed))
+    slot.max_ns.store(value, kRelaxed);
+
+  slot.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+void Writer::RecordMemory(uint32_t pid, size_t private_mb, size_t peak_mb) {
+  if (region_ == nullptr || pid != region_->pid.load(kRelaxed))
+    return;
+
+  const auto sequence = region_->memory_sequence.load(kRelaxed);
+  region_->memory_sequence.store(sequence + 1, kRelaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  region_->private_mb.store(private_mb, kRelaxed);
+  region_->peak_mb.store(peak_mb, kRelaxed);
+  region_->memory_sequence.store(sequence + 2, std::memory_order_release);
+}
+
+Reader::~Reader() {
+  detail::CloseSharedMemory(memory_);
+}
+
+bool Reader::Open(const std::string& name) {
+  detail::CloseSharedMemory(memory_);
+  region_ = nullptr;
+  if (!detail::OpenSharedMemory(name, sizeof(Region), memory_))
+    return false;
+
+  const auto region = static_cast<const Region*>(memory_.view);
+  if (region->magic != kMagic || region->version != kVersion ||
+      region->region_size != sizeof(Region)) {
+    detail::CloseSharedMemory(memory_);
+    return false;
+  }
+
+  std::atomic_thread_fence(std::memory_order_acquire);
+  region_ = region;
+  return true;
+}
+
+bool Reader::Read(Snapshot& snapshot) const {
+  if (region_ == nullptr)
+    return false;
+
+  snapshot.pid = region_->pid.load(kRelaxed);
+  for (int retry = 0;; ++retry) {
+    if (retry == kMaxReadRetries)
+      return false;
+
+    const auto begin = region_->memory_sequence.load(std::memory_order_acquire);
+    if (begin & 1) {
+      std::this_thread::yield();
+      continue;
+    }
+    snapshot.private_mb = region_->private_mb.load(kRelaxed);
+    snapshot.peak_mb = region_->peak_mb.load(kRelaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (region_->memory_sequence.load(kRelaxed) == begin)
+      break;
+  }
+
+  const auto count = (std::min)(
+      region_->segment_count.load(std::memory_order_acquire), kMaxSegments);
+  snapshot.segments.resize(count);
+  for (uint32_t i = 0; i < count; ++i) {
+    const auto& slot = region_->slots[i];
+    auto& segment = snapshot.segments[i];
+    segment.name.assign(slot.name, strnlen(slot.name, kMaxNameLength));
+    if (!ReadSlot(slot, segment))
+      return false;
+  }
+  return true;
+}
+}  // namespace shared_metrics
+}  // namespace performance
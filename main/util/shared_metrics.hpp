@@ -0,0 +1,183 @@
+/*
+ Performance profiler - live metrics in shared memory.
+
+ Copyright (c) 2024 Thomas Bruckschlegel. All rights reserved.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace performance {
+namespace shared_metrics {
+constexpr uint32_t kMagic = 0x4652504d;  /// "MPRF"
+constexpr uint32_t kVersion = 1;
+constexpr uint32_t kMaxSegments = 256;
+constexpr uint32_t kMaxNameLength = 64;
+/// Bucket i counts the samples in [2^(i-1), 2^i) ns, bucket 0 counts 0 ns.
+constexpr uint32_t kHistogramBuckets = 48;
+
+using counter_t = std::atomic<uint64_t>;
+static_assert(counter_t::is_always_lock_free);
+
+/**
+ * Per-segment counters. The producer is the only writer of a slot and
+ * protects every update with the sequence number (seqlock): it is odd while
+ * the slot is being written, readers retry when it is odd or has changed.
+ */
+struct SegmentSlot {
+  std::atomic<uint32_t> sequence;
+  char name[kMaxNameLength];
+  counter_t count;
+  counter_t total_ns;
+  counter_t min_ns;
+  counter_t max_ns;
+  counter_t last_ns;
+  counter_t histogram[kHistogramBuckets];
+};
+
+/**
+ * Layout of the shared memory region. Slots are appended, segment_count is
+ * published after the slot was initialized. pid is the producer that owns
+ * the region, 0 after it has detached.
+ */
+struct Region {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t region_size;
+  std::atomic<uint32_t> pid;
+  std::atomic<uint32_t> segment_count;
+  std::atomic<uint32_t> memory_sequence;
+  counter_t private_mb;
+  counter_t peak_mb;
+  SegmentSlot slots[kMaxSegments];
+};
+
+/// Copy of a segment slot taken by a reader.
+struct SegmentSnapshot {
+  std::string name;
+  uint64_t count{};
+  uint64_t total_ns{};
+  uint64_t min_ns{};
+  uint64_t max_ns{};
+  uint64_t last_ns{};
+  uint64_t histogram[kHistogramBuckets]{};
+
+  /**
+   * @brief Estimate a percentile from the histogram.
+   * @param percentile the percentile in [0, 100].
+   * @return the estimated time in nanoseconds.
+   */
+  double Percentile(double percentile) const;
+};
+
+/// Copy of the whole region taken by a reader.
+struct Snapshot {
+  uint32_t pid{};
+  uint64_t private_mb{};
+  uint64_t peak_mb{};
+  std::vector<SegmentSnapshot> segments;
+};
+
+namespace detail {
+struct SharedMemory {
+  void* handle{};
+  void* view{};
+  bool existed{};  /// CreateSharedMemory attached to an existing region
+};
+
+/// Platform specific, see util/win/shared_metrics_win.cpp.
+bool CreateSharedMemory(const std::string& name, size_t size,
+    SharedMemory& memory);
+bool OpenSharedMemory(const std::string& name, size_t size,
+    SharedMemory& memory);
+void CloseSharedMemory(SharedMemory& memory);
+uint32_t CurrentProcessId();
+bool IsProcessRunning(uint32_t pid);
+}  // namespace detail
+
+/**
+ * Publishes segment counters into a named shared memory region. Not thread
+ * safe, the profiler calls it under its own lock.
+ */
+class Writer final {
+public:
+  Writer() = delete;
+  Writer(const Writer&) = delete;
+  Writer& operator=(const Writer&) = delete;
+
+  /**
+   * @brief Create the named shared memory region. A region left behind by a
+   * previous producer, e.g. kept open by perf_top, is taken over and reset.
+   * A region of a producer that is still running isn't opened, two writers
+   * would break the sequence numbers of the slots.
+   * @param name the region name.
+   */
+  explicit Writer(const std::string& name);
+  ~Writer();
+
+  /**
+   * @brief Check whether the region was created.
+   * @return true if the region is available.
+   */
+  bool IsOpen() const {
+    return region_ != nullptr;
+  }
+
+  /**
+   * @brief Add a sample to a segment, the segment gets a slot on first use.
+   * Samples of segments that don't fit into the region are dropped.
+   * @param segment_name the segment name.
+   * @param ns the segment time in nanoseconds.
+   */
+  void Record(const std::string& segment_name, double ns);
+
+  /**
+   * @brief Publish the memory usage of the current process.
+   * @param pid the process ID, other processes are ignored.
+   * @param private_mb the current private memory in MB.
+   * @param peak_mb the peak working set in MB.
+   */
+  void RecordMemory(uint32_t pid, size_t private_mb, size_t peak_mb);
+
+private:
+  detail::SharedMemory memory_;
+  Region* region_{};
+  std::unordered_map<std::string, uint32_t> slots_;
+};
+
+/**
+ * Attaches to the shared memory region of a producer, read-only.
+ */
+class Reader final {
+public:
+  Reader() = default;
+  Reader(const Reader&) = delete;
+  Reader& operator=(const Reader&) = delete;
+  ~Reader();
+
+  /**
+   * @brief Attach to a named region and check its layout version.
+   * @param name the region name.
+   * @return true on success.
+   */
+  bool Open(const std::string& name);
+
+  /**
+   * @brief Take a consistent copy of every segment slot.
+   * @param snapshot receives the copy.
+   * @return false if no region is attached or a copy couldn't be taken,
+   * e.g. the producer died while updating the region.
+   */
+  bool Read(Snapshot& snapshot) const;
+
+private:
+  detail::SharedMemory memory_;
+  const Region* region_{};
+};
+}  // namespace shared_metrics
+}  // namespace performance
@@ -0,0 +1,26 @@
+/*
+ Performance profiler - segments of asynchronous tasks, Windows specific code.
+
+ Copyright (c) 2024 Thomas Bruckschlegel. All rights reserved.
+*/
+
+#include "util/async_segment.hpp"
+#include <Windows.h>
+
+namespace performance {
+namespace detail {
+double CurrentThreadCpuTime() {
+  FILETIME creation{};
+  FILETIME exit{};
+  FILETIME kernel{};
+  FILETIME user{};
+  if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+    return 0;
+
+  constexpr auto to_100ns = [](const FILETIME& t) {
+    return (static_cast<uint64_t>(t.dwHighDateTime) << 32) | t.dwLowDateTime;
+  };
+  return static_cast<double>(to_100ns(kernel) + to_100ns(user)) * 100.0;
+}
+}  // namespace detail
+}  // namespace performance
@@ -0,0 +1,195 @@
+/*
+ Benchmark execution environment - Windows specific code.
+
+ Copyright (c) 2024 Thomas Bruckschlegel. All rights reserved.
+*/
+
+#include "util/benchmark_environment.hpp"
+#include <algorithm>
+#include <vector>
+#include <Windows.h>
+#include <powrprof.h>
+
+#pragma comment(lib, "powrprof")
+
+namespace performance {
+namespace {
+// Result of CallNtPowerInformation(ProcessorInformation), not declared in the
+// SDK headers.
+struct ProcessorPowerInformation {
+  ULONG number;
+  ULONG max_mhz;
+  ULONG current_mhz;
+  ULONG mhz_limit;
+  ULONG max_idle_state;
+  ULONG current_idle_state;
+};
+
+// "Ultimate Performance" power scheme, not declared in the SDK headers.
+constexpr GUID kUltimatePerformance = { 0xe9a42b02, 0xd5df, 0x448d,
+  { 0xaa, 0x00, 0x03, 0xf1, 0x47, 0x49, 0xeb, 0x61 } };
+
+constexpr size_t kPrefaultStackBytes = 256 * 1024;
+constexpr size_t kPageBytes = 4096;
+
+std::string GetPowerSchemeName(const GUID& scheme) {
+  if (IsEqualGUID(scheme, GUID_MIN_POWER_SAVINGS))
+    return "High performance";
+  if (IsEqualGUID(scheme, kUltimatePerformance))
+    return "Ultimate performance";
+  if (IsEqualGUID(scheme, GUID_TYPICAL_POWER_SAVINGS))
+    return "Balanced";
+  if (IsEqualGUID(scheme, GUID_MAX_POWER_SAVINGS))
+    return "Power saver";
+  return "Custom";
+}
+}  // namespace
+
+WorkingSetLock::WorkingSetLock(size_t bytes) {
+  if (bytes == 0)
+    return;
+
+  // Windows has no mlockall(), a hard minimum working set keeps the pages
+  // touched by the benchmark resident instead.
+  SIZE_T min_size{};
+  SIZE_T max_size{};
+  DWORD flags{};
+  if (!GetProcessWorkingSetSizeEx(GetCurrentProcess(), &min_size, &max_size,
+          &flags))
+    return;
+
+  previous_min_ = min_size;
+  previous_max_ = max_size;
+  previous_flags_ = flags;
+  min_size += bytes;
+  max_size = (std::max)(max_size, min_size);
+  locked_ = SetProcessWorkingSetSizeEx(GetCurrentProcess(), min_size, max_size,
+                QUOTA_LIMITS_HARDWS_MIN_ENABLE |
+                    QUOTA_LIMITS_HARDWS_MAX_DISABLE) != FALSE;
+}
+
+WorkingSetLock::~WorkingSetLock() {
+  if (!locked_)
+    return;
+
+  // The previous flags tell whether the old limits were hard or soft.
+  SetProcessWorkingSetSizeEx(GetCurrentProcess(), previous_min_, previous_max_,
+      (previous_flags_ & QUOTA_LIMITS_HARDWS_MIN_ENABLE
+              ? QUOTA_LIMITS_HARDWS_MIN_ENABLE
+              : QUOTA_LIMITS_HARDWS_MIN_DISABLE) |
+          (previous_flags_ & QUOTA_LIMITS_HARDWS_MAX_ENABLE
+                  ? QUOTA_LIMITS_HARDWS_MAX_ENABLE
+                  : QUOTA_LIMITS_HARDWS_MAX_DISABLE));
+}
+
+namespace environment {
+bool PinCurrentThread(uint32_t cpu) {
+  // The CPU index counts over all processor groups, machines with more than
+  // 64 logical CPUs have several of them.
+  const WORD groups = GetActiveProcessorGroupCount();
+  for (WORD group = 0; group < groups; ++group) {
+    const DWORD count = GetActiveProcessorCount(group);
+    if (cpu < count) {
+      GROUP_AFFINITY affinity{};
+      affinity.Group = group;
+      affinity.Mask = KAFFINITY{ 1 } << cpu;
+      return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) !=
+             FALSE;
+    }
+    cpu -= count;
+  }
+  return false;
+}
+
+bool RaiseCurrentThreadPriority() {
+  const bool process =
+      SetPriorityClass(GetCurrentProcess(), HIGH_PRIORITY_CLASS) != FALSE;
+  const bool thread =
+      SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST) != FALSE;
+  return process && thread;
+}
+
+bool GetWorkingSetLimits(size_t& minimum, size_t& maximum) {
+  SIZE_T min_size{};
+  SIZE_T max_size{};
+  DWORD flags{};
+  if (!GetProcessWorkingSetSizeEx(GetCurrentProcess(), &min_size, &max_size,
+          &flags))
+    return false;
+
+  minimum = min_size;
+  maximum = max_size;
+  return true;
+}
+
+__declspec(noinline) void PrefaultStack() {
+  volatile char stack[kPrefaultStackBytes];
+  for (size_t i = 0; i < kPrefaultStackBytes; i += kPageBytes)
+    stack[i] = 0;
+}
+
+EnvironmentSnapshot Capture() {
+  EnvironmentSnapshot snapshot{};
+  snapshot.logical_cpus = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+
+  // The power scheme is the Windows counterpart of the frequency governor, a
+  // minimum processor state of 100% pins the CPUs at their nominal frequency.
+  GUID* scheme = nullptr;
+  if (PowerGetActiveScheme(nullptr, &scheme) == ERROR_SUCCESS) {
+    snapshot.power_scheme = GetPowerSchemeName(*scheme);
+
+    DWORD min_state{};
+    if (PowerReadACValueIndex(nullptr, scheme,
+            &GUID_PROCESSOR_SETTINGS_SUBGROUP, &GUID_PROCESSOR_THROTTLE_MINIMUM,
+            &min_state) == ERROR_SUCCESS)
+      snapshot.performance_scheme = min_state >= 100;
+
+    DWORD boost_mode{};
+    if (PowerReadACValueIndex(nullptr, scheme,
+            &GUID_PROCESSOR_SETTINGS_SUBGROUP, &GUID_PROCESSOR_PERF_BOOST_MODE,
+            &boost_mode) == ERROR_SUCCESS)
+      snapshot.boost_enabled = boost_mode != 0;
+
+    LocalFree(scheme);
+  }
+
+  DWORD length{};
+  GetLogicalProcessorInformationEx(RelationProcessorCore, nullptr, &length);
+  std::vector<char> buffer(length);
+  if (length > 0 &&
+      GetLogicalProcessorInformationEx(RelationProcessorCore,
+          reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(
+              buffer.data()),
+          &length)) {
+    for (DWORD offset = 0; offset < length;) {
+      const auto info =
+          reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(
+              buffer.data() + offset);
+      ++snapshot.physical_cores;
+      if (info->Processor.Flags & LTP_PC_SMT)
+        snapshot.smt_enabled = true;
+      offset += info->Size;
+    }
+  }
+
+  std::vector<ProcessorPowerInformation> power(snapshot.logical_cpus);
+  if (!power.empty() &&
+      CallNtPowerInformation(ProcessorInformation, nullptr, 0, power.data(),
+          static_cast<ULONG>(power.size() * sizeof(power[0]))) == 0) {
+    for (auto&& cpu : power) {
+      if (cpu.max_mhz == 0)
+        continue;
+      snapshot.max_mhz =
+          (std::max)(snapshot.max_mhz, static_cast<uint32_t>(cpu.max_mhz));
+      snapshot.current_mhz = snapshot.current_mhz == 0
+                                 ? static_cast<uint32_t>(cpu.current_mhz)
+                                 : (std::min)(snapshot.current_mhz,
+                                       static_cast<uint32_t>(cpu.current_mhz));
+    }
+  }
+
+  Evaluate(snapshot);
+  return snapshot;
+}
+}  // namespace environment
+}  // namespace performance
@@ -0,0 +1,23 @@
+/*
+ Performance profiler - runtime segment filter - Windows specific code.
+
+ Copyright (c) 2024 Thomas Bruckschlegel. All rights reserved.
+*/
+
+#include "util/segment_filter.hpp"
+#include <Windows.h>
+
+namespace performance {
+namespace detail {
+std::string GetEnvironmentString(const std::string& name) {
+  const auto size = GetEnvironmentVariableA(name.c_str(), nullptr, 0);
+  if (size == 0)
+    return {};
+
+  std::string value(size, '\0');
+  const auto length = GetEnvironmentVariableA(name.c_str(), value.data(), size);
+  value.resize(length < size ? length : 0);
+  return value;
+}
+}  // namespace detail
+}  // namespace performance
@@ -0,0 +1,88 @@
+/*
+ Performance profiler - live metrics in shared memory - Windows specific code.
+
+ Copyright (c) 2024 Thomas Bruckschlegel. All rights reserved.
+*/
+
+#include "util/shared_metrics.hpp"
+#include <Windows.h>
+
+namespace performance {
+namespace shared_metrics {
+namespace detail {
+namespace {
+// Named file mappings are the Windows counterpart of POSIX shared memory,
+// "Local\" keeps them in the session and doesn't need extra privileges.
+std::string GetMappingName(const std::string& name) {
+  return "Local\\" + name;
+}
+}  // namespace
+
+bool CreateSharedMemory(const std::string& name,
+    size_t size,
+    SharedMemory& memory) {
+  const auto size64 = static_cast<uint64_t>(size);
+  auto handle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr,
+      PAGE_READWRITE, static_cast<DWORD>(size64 >> 32),
+      static_cast<DWORD>(size64 & 0xffffffff), GetMappingName(name).c_str());
+  if (handle == nullptr)
+    return false;
+
+  // The handle refers to the existing mapping if the name was taken.
+  memory.existed = GetLastError() == ERROR_ALREADY_EXISTS;
+  auto view = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, size);
+  if (view == nullptr) {
+    CloseHandle(handle);
+    return false;
+  }
+
+  memory.handle = handle;
+  memory.view = view;
+  return true;
+}
+
+bool OpenSharedMemory(const std::string& name,
+    size_t size,
+    SharedMemory& memory) {
+  auto handle =
+      OpenFileMappingA(FILE_MAP_READ, FALSE, GetMappingName(name).c_str());
+  if (handle == nullptr)
+    return false;
+
+  auto view = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, size);
+  if (view == nullptr) {
+    CloseHandle(handle);
+    return false;
+  }
+
+  memory.handle = handle;
+  memory.view = view;
+  return true;
+}
+
+void CloseSharedMemory(SharedMemory& memory) {
+  if (memory.view != nullptr)
+    UnmapViewOfFile(memory.view);
+  if (memory.handle != nullptr)
+    CloseHandle(memory.handle);
+  memory = {};
+}
+
+uint32_t CurrentProcessId() {
+  return GetCurrentProcessId();
+}
+
+bool IsProcessRunning(uint32_t pid) {
+  auto process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+  if (process == nullptr)
+    return GetLastError() == ERROR_ACCESS_DENIED;
+
+  DWORD exit_code{};
+  const bool running = GetExitCodeProcess(process, &exit_code) != FALSE &&
+                       exit_code == STILL_ACTIVE;
+  CloseHandle(process);
+  return running;
+}
+}  // namespace detail
+}  // namespace shared_metrics
+}  // namespace performance